@@ -1,5 +1,6 @@
 #include <avr/io.h>
 #include <avr/eeprom.h>
+#include "trace.h"
 
 // Turn this into interrupt later
 uint16_t adc(uint8_t pin)
@@ -12,5 +13,6 @@ uint16_t adc(uint8_t pin)
   while (ADCSRA & (1 << ADSC))
     ;
 
+  trace_adc(ADC);
   return ADC;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <avr/common.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 
 #define _DDR(port) (*(&port - 1)) // Attiny DDRx registers are at one byte lower address
 #define _PIN(port) (*(&port - 2)) // Attiny PINx registers are at two byte lower address
@@ -10,6 +10,9 @@
 
 #define _DDR(port) (*(&port - 1)) // Attiny DDRx registers are at one byte lower address
 
+#else
+#include "host.h"
+
 #endif
 
 #endif
\ No newline at end of file
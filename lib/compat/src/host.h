@@ -0,0 +1,16 @@
+#ifndef _KOREY_HOST
+#define _KOREY_HOST
+
+// Host (PC) build, used by the tools in tools/. Ports are plain memory and ADC readings come from the tool.
+#include <stdint.h>
+
+#define _DDR(port) (*(&port - 1)) // Keep the AVR layout: pass a pointer into an array of at least three bytes
+#define _PIN(port) (*(&port - 2))
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+
+uint16_t adc(uint8_t pin);
+
+#endif
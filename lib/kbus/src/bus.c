@@ -0,0 +1,172 @@
+#include "bus.h"
+#include "clock.h"
+#include <util/atomic.h>
+
+#define BUS_STOP_BIT 9
+
+static void release_line(struct bus_t *b)
+{
+    _DDR(*b->port) &= ~(1 << b->pin);
+}
+
+static void drive_line(struct bus_t *b, const uint8_t level)
+{
+    if (level)
+        release_line(b);
+    else
+        _DDR(*b->port) |= (1 << b->pin);
+}
+
+static void start_bit_timer(struct bus_t *b, const uint16_t count)
+{
+    *b->pcmsk &= ~(1 << b->pin);
+    TCNT1 = count;
+    TIFR1 = (1 << OCF1A);
+    TIMSK1 |= (1 << OCIE1A);
+}
+
+static void stop_bit_timer(struct bus_t *b)
+{
+    TIMSK1 &= ~(1 << OCIE1A);
+    b->state = BUS_IDLE;
+    *b->pcmsk |= (1 << b->pin);
+}
+
+/**
+ * @brief Set up the bus pin as a released open-drain line and start Timer1 at the bit rate.
+ *
+ * @param b Bus
+ * @param port Port register of the bus pin
+ * @param pin Bus pin, with an external pull-up
+ */
+void init_bus(struct bus_t *b, volatile uint8_t *port, uint8_t pin)
+{
+    b->port = port;
+    b->pin = pin;
+    b->state = BUS_IDLE;
+    b->frame_ready = 0;
+    init_bus_parser(&b->parser);
+
+    // Low whenever driven, released otherwise.
+    *port &= ~(1 << pin);
+    release_line(b);
+
+    if (port == &PORTA)
+    {
+        b->pcmsk = &PCMSK0;
+        GIMSK |= (1 << PCIE0);
+    }
+    else
+    {
+        b->pcmsk = &PCMSK1;
+        GIMSK |= (1 << PCIE1);
+    }
+    *b->pcmsk |= (1 << pin);
+
+    init_clock_timer1(BUS_BIT_COUNTS);
+}
+
+/**
+ * @brief Call from the pin change ISR. A falling edge on an idle bus starts a byte; the first compare lands in the
+ *        middle of the start bit.
+ *
+ * @param b Bus
+ */
+void bus_pin_change(struct bus_t *b)
+{
+    if (b->state != BUS_IDLE || (_PIN(*b->port) & (1 << b->pin)))
+        return;
+
+    b->state = BUS_RX;
+    b->bit = 0;
+    start_bit_timer(b, OCR1A / 2);
+}
+
+/**
+ * @brief Call from the Timer1 compare A ISR, once per bit.
+ *
+ * @param b Bus
+ */
+void bus_bit_tick(struct bus_t *b)
+{
+    const uint8_t level = _PIN(*b->port) & (1 << b->pin);
+
+    if (b->state == BUS_RX)
+    {
+        if (b->bit == 0)
+        {
+            if (level) // Glitch, not a start bit
+                stop_bit_timer(b);
+        }
+        else if (b->bit < BUS_STOP_BIT)
+        {
+            b->shift >>= 1;
+            if (level)
+                b->shift |= 0x80;
+        }
+        else
+        {
+            // Drop bytes with a framing error and anything that arrives before the last request was taken.
+            if (level && !b->frame_ready && parse_bus_byte(&b->parser, b->shift))
+                b->frame_ready = 1;
+            stop_bit_timer(b);
+            return;
+        }
+        b->bit++;
+    }
+    else if (b->state == BUS_TX)
+    {
+        if (b->bit == 0)
+        {
+            if (b->tx_index == b->tx_length)
+            {
+                init_bus_parser(&b->parser);
+                stop_bit_timer(b);
+                return;
+            }
+            b->shift = b->tx[b->tx_index++];
+            drive_line(b, 0);
+        }
+        else if (b->bit < BUS_STOP_BIT)
+        {
+            drive_line(b, b->shift & 1);
+            b->shift >>= 1;
+        }
+        else
+        {
+            release_line(b);
+            b->bit = 0;
+            return;
+        }
+        b->bit++;
+    }
+}
+
+/**
+ * @brief Queue a frame for transmission. Sending happens from the Timer1 interrupt. Overwrites parser.frame, so
+ *        clear frame_ready first.
+ *
+ * @param b Bus
+ * @param f Frame
+ * @return uint8_t 1 if sending started, 0 if the bus was busy.
+ */
+uint8_t send_bus_frame(struct bus_t *b, const struct bus_frame_t *f)
+{
+    uint8_t started = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (b->state == BUS_IDLE)
+        {
+            b->tx_length = encode_bus_frame(f, b->tx);
+            b->tx_index = 0;
+            b->bit = 0;
+            b->state = BUS_TX;
+            // First bit goes out on the next compare.
+            start_bit_timer(b, 0);
+            started = 1;
+        }
+    }
+
+    return started;
+}
@@ -0,0 +1,56 @@
+#ifndef _BUS_KOREY
+#define _BUS_KOREY
+
+#include "hardwaredefs.h"
+#include "busproto.h"
+
+/*
+ * Half-duplex, single wire, open-drain software UART for busproto frames: 8N1, LSB first, idle high through
+ * one external pull-up on the bus. Bits are timed by Timer1 (see init_clock_timer1) and start bits are caught
+ * with the pin change interrupt, so nothing blocks and the CPU sleeps between bits. Both interrupts wait while
+ * interrupts are off. A late start edge moves every sample of its byte off the middle of the bit, and a late
+ * bit tick moves its own sample. Half a bit is 3.2 ms, and a node clock 2 % off uses 1.2 ms of it by the stop
+ * bit, which leaves 2 ms for a start edge and a sample that both wait for the tick ISR. Its longest path is
+ * about 600 cycles, 0.6 ms at CLOCK_NORMAL, where a bus node rests (see src/main.c). tools/busmaster/bussim
+ * finds that tick ISRs of up to about 1400 cycles work there.
+ */
+
+// Bit length in counts of 125 khz: 800 * 8 us = 6.4 ms, 156.25 baud.
+#define BUS_BIT_COUNTS 800
+// Idle bit times a master leaves after a reply before the next request. The node sees its last stop bit out
+// before it listens again, and the master has already read that stop bit half a bit earlier.
+#define BUS_TURNAROUND_BITS 2
+
+enum bus_state
+{
+    BUS_IDLE,
+    BUS_RX,
+    BUS_TX,
+};
+
+struct bus_t
+{
+    volatile uint8_t *port;
+    uint8_t pin;
+    volatile uint8_t *pcmsk; // Pin change mask register for the pin's port
+    volatile uint8_t state;  // enum bus_state
+    uint8_t bit;             // Bit position within the current byte
+    uint8_t shift;           // Byte being received or sent
+    volatile uint8_t frame_ready; // parser.frame holds a request until the main loop clears this
+    // Nothing is received while sending, and a reply is only queued once its request has been handled, so the
+    // outgoing frame reuses the parser's memory. The parser starts over when sending ends.
+    union
+    {
+        struct bus_parser_t parser;
+        uint8_t tx[BUS_FRAME_MAX];
+    };
+    uint8_t tx_length;
+    uint8_t tx_index;
+};
+
+void init_bus(struct bus_t *b, volatile uint8_t *port, uint8_t pin);
+void bus_pin_change(struct bus_t *b);
+void bus_bit_tick(struct bus_t *b);
+uint8_t send_bus_frame(struct bus_t *b, const struct bus_frame_t *f);
+
+#endif
@@ -0,0 +1,179 @@
+#include "busproto.h"
+
+enum bus_parser_state
+{
+    BUS_WAIT_SYNC,
+    BUS_WAIT_ADDRESS,
+    BUS_WAIT_COMMAND,
+    BUS_WAIT_LENGTH,
+    BUS_WAIT_PAYLOAD,
+    BUS_WAIT_CRC,
+};
+
+/**
+ * @brief CRC-8 with the Dallas/Maxim polynomial (x^8 + x^5 + x^4 + 1), bit by bit to keep flash use down.
+ *
+ * @param crc CRC so far, 0 to start
+ * @param byte Next byte
+ * @return uint8_t
+ */
+uint8_t crc8_update(uint8_t crc, uint8_t byte)
+{
+    crc ^= byte;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+
+    return crc;
+}
+
+void init_bus_parser(struct bus_parser_t *p)
+{
+    p->state = BUS_WAIT_SYNC;
+}
+
+/**
+ * @brief Feed one received byte. Small enough to run from the receive interrupt.
+ *
+ * @param p Parser
+ * @param byte Received byte
+ * @return uint8_t 1 when p->frame holds a complete frame with a valid CRC.
+ */
+uint8_t parse_bus_byte(struct bus_parser_t *p, const uint8_t byte)
+{
+    switch (p->state)
+    {
+    case BUS_WAIT_SYNC:
+        if (byte == BUS_SYNC)
+        {
+            p->crc = 0;
+            p->state = BUS_WAIT_ADDRESS;
+        }
+        return 0;
+
+    case BUS_WAIT_ADDRESS:
+        p->frame.address = byte;
+        p->state = BUS_WAIT_COMMAND;
+        break;
+
+    case BUS_WAIT_COMMAND:
+        p->frame.command = byte;
+        p->state = BUS_WAIT_LENGTH;
+        break;
+
+    case BUS_WAIT_LENGTH:
+        if (byte > BUS_PAYLOAD_MAX)
+        {
+            p->state = BUS_WAIT_SYNC;
+            return 0;
+        }
+        p->frame.length = byte;
+        p->index = 0;
+        p->state = byte ? BUS_WAIT_PAYLOAD : BUS_WAIT_CRC;
+        break;
+
+    case BUS_WAIT_PAYLOAD:
+        p->frame.payload[p->index++] = byte;
+        if (p->index == p->frame.length)
+            p->state = BUS_WAIT_CRC;
+        break;
+
+    default:
+    case BUS_WAIT_CRC:
+        p->state = BUS_WAIT_SYNC;
+        return byte == p->crc;
+    }
+
+    p->crc = crc8_update(p->crc, byte);
+    return 0;
+}
+
+/**
+ * @brief Serialize a frame for transmission.
+ *
+ * @param f Frame
+ * @param buffer Output
+ * @return uint8_t Number of bytes in buffer.
+ */
+uint8_t encode_bus_frame(const struct bus_frame_t *f, uint8_t buffer[BUS_FRAME_MAX])
+{
+    uint8_t n = 0;
+
+    buffer[n++] = BUS_SYNC;
+    buffer[n++] = f->address;
+    buffer[n++] = f->command;
+    buffer[n++] = f->length;
+    for (uint8_t i = 0; i < f->length; i++)
+        buffer[n++] = f->payload[i];
+
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < n; i++)
+        crc = crc8_update(crc, buffer[i]);
+    buffer[n++] = crc;
+
+    return n;
+}
+
+static void put_int16(uint8_t *p, const int16_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (uint16_t)value >> 8;
+}
+
+static int16_t get_int16(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (uint16_t)p[1] << 8);
+}
+
+/**
+ * @brief Answer a request addressed to this node.
+ *
+ * @param node Node state
+ * @param request Received frame
+ * @param response Reply to send
+ * @return uint8_t 1 if response should be sent, 0 if the frame is not a request for this node.
+ */
+uint8_t handle_bus_request(struct bus_node_t *node, const struct bus_frame_t *request, struct bus_frame_t *response)
+{
+    if (request->address != node->address)
+        return 0;
+
+    response->address = node->address | BUS_RESPONSE;
+    response->command = request->command;
+    response->length = 0;
+
+    const int16_t low = get_int16(&request->payload[0]);
+    const int16_t high = get_int16(&request->payload[2]);
+
+    switch (request->command)
+    {
+    case BUS_CMD_SET_THRESHOLDS:
+        if (request->length != BUS_THRESHOLDS_LENGTH || low >= high || low < node->thresh_min ||
+            high > node->thresh_max)
+        {
+            response->command |= BUS_NAK;
+            return 1;
+        }
+
+        node->requested_low = low;
+        node->requested_high = high;
+        node->thresholds_requested = 1;
+        node->low_thresh = low;
+        node->high_thresh = high;
+
+        // Reply with the new status.
+        // fall through
+    case BUS_CMD_STATUS:
+        put_int16(&response->payload[0], node->temperature);
+        put_int16(&response->payload[2], node->low_thresh);
+        put_int16(&response->payload[4], node->high_thresh);
+        response->payload[6] = node->flags;
+        response->length = BUS_STATUS_LENGTH;
+        break;
+
+    default:
+        response->command |= BUS_NAK;
+        break;
+    }
+
+    return 1;
+}
@@ -0,0 +1,80 @@
+#ifndef _BUS_PROTO_KOREY
+#define _BUS_PROTO_KOREY
+
+#include "hardwaredefs.h"
+
+/*
+ * Multi-drop bus protocol. One master polls nodes; nodes only speak when addressed. Frames are
+ *
+ *   [BUS_SYNC] [address] [command] [length] [payload...] [crc]
+ *
+ * with the CRC-8 (Dallas/Maxim) of address through payload. Replies carry BUS_RESPONSE in the address byte
+ * and echo the command, or the command with BUS_NAK set if the request was rejected. 16-bit values are sent
+ * least significant byte first.
+ *
+ *   BUS_CMD_STATUS          Request: no payload
+ *                           Reply: temperature, low threshold, high threshold (int16 each), flags (uint8)
+ *   BUS_CMD_SET_THRESHOLDS  Request: low threshold, high threshold (int16 each)
+ *                           Reply: status, as for BUS_CMD_STATUS
+ */
+
+#define BUS_SYNC 0xA5
+#define BUS_RESPONSE 0x80
+#define BUS_NAK 0x40
+#define BUS_ADDRESS_MIN 1
+#define BUS_ADDRESS_MAX 99
+
+#define BUS_CMD_STATUS 0x01
+#define BUS_CMD_SET_THRESHOLDS 0x02
+
+#define BUS_STATUS_LENGTH 7
+#define BUS_THRESHOLDS_LENGTH 4
+
+// Status flags
+#define BUS_FLAG_RELAY 0x1
+#define BUS_FLAG_SENSOR_ERROR 0x2
+
+#define BUS_PAYLOAD_MAX 8
+#define BUS_FRAME_MAX (BUS_PAYLOAD_MAX + 5)
+
+struct bus_frame_t
+{
+    uint8_t address;
+    uint8_t command;
+    uint8_t length;
+    uint8_t payload[BUS_PAYLOAD_MAX];
+};
+
+struct bus_parser_t
+{
+    uint8_t state;
+    uint8_t index;
+    uint8_t crc;
+    struct bus_frame_t frame;
+};
+
+// What a node exposes on the bus. The main loop keeps the status fields current and applies requested
+// thresholds.
+struct bus_node_t
+{
+    uint8_t address;
+    int16_t temperature;
+    int16_t low_thresh;
+    int16_t high_thresh;
+    uint8_t flags;
+    int16_t thresh_min; // Writes outside thresh_min..thresh_max are refused
+    int16_t thresh_max;
+    uint8_t thresholds_requested; // Set when a master wrote new thresholds
+    int16_t requested_low;
+    int16_t requested_high;
+};
+
+uint8_t crc8_update(uint8_t crc, uint8_t byte);
+
+void init_bus_parser(struct bus_parser_t *p);
+uint8_t parse_bus_byte(struct bus_parser_t *p, const uint8_t byte);
+uint8_t encode_bus_frame(const struct bus_frame_t *f, uint8_t buffer[BUS_FRAME_MAX]);
+
+uint8_t handle_bus_request(struct bus_node_t *node, const struct bus_frame_t *request, struct bus_frame_t *response);
+
+#endif
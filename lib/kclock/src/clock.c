@@ -0,0 +1,130 @@
+#include "clock.h"
+#include <avr/power.h>
+#include <util/atomic.h>
+
+#define CLOCK_CS_MASK ((1 << CS02) | (1 << CS01) | (1 << CS00))
+#define CLOCK_CS1_MASK ((1 << CS12) | (1 << CS11) | (1 << CS10))
+#define CLOCK_ADPS_MASK ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))
+
+struct clock_setting_t
+{
+    uint8_t clock_div;    // CLKPR prescaler, see clock_div_t in avr/power.h
+    uint8_t timer0_cs;    // Timer0 clock select bits
+    uint8_t timer0_shift; // Timer0 runs at 15.625 khz << shift
+    uint8_t adc_ps;       // ADC prescaler bits, keeping the ADC clock at 125 khz
+    uint8_t timer1_cs;    // Timer1 clock select bits
+    uint8_t timer1_shift; // Timer1 runs at 125 khz << shift
+};
+
+// Indexed by enum clock_speed.
+static const struct clock_setting_t CLOCK_SETTINGS[] PROGMEM =
+    {
+        // 8 Mhz: timer0 /256, ADC /64, timer1 /64
+        {clock_div_1, (1 << CS02), 1, (1 << ADPS2) | (1 << ADPS1), (1 << CS11) | (1 << CS10), 0},
+        // 1 Mhz: timer0 /64, ADC /8, timer1 /8
+        {clock_div_8, (1 << CS01) | (1 << CS00), 0, (1 << ADPS1) | (1 << ADPS0), (1 << CS11), 0},
+        // 250 khz: timer0 /8, ADC /2, timer1 /1
+        {clock_div_32, (1 << CS01), 1, (1 << ADPS0), (1 << CS10), 1},
+};
+
+static enum clock_speed current_speed = CLOCK_NORMAL;
+static uint8_t timer0_shift = 0; // CLOCK_SETTINGS[current_speed].timer0_shift, read from ISRs
+// Timer1 period in counts of 125 khz, 0 while Timer1 is not used.
+static uint16_t timer1_counts = 0;
+
+/**
+ * @brief Switch the CPU clock and retune Timer0, Timer1 and the ADC prescaler so that tick, bus bit and ADC clock
+ *        timing stay the same. Must not be called while an ADC conversion is running.
+ *
+ * @param speed New CPU speed
+ */
+void set_clock_speed(const enum clock_speed speed)
+{
+    if (speed == current_speed)
+        return;
+
+    const uint8_t old_shift = pgm_read_byte(&CLOCK_SETTINGS[current_speed].timer0_shift);
+    const uint8_t new_shift = pgm_read_byte(&CLOCK_SETTINGS[speed].timer0_shift);
+    const uint8_t timer0_cs = pgm_read_byte(&CLOCK_SETTINGS[speed].timer0_cs);
+    const uint8_t adc_ps = pgm_read_byte(&CLOCK_SETTINGS[speed].adc_ps);
+    const clock_div_t clock_div = pgm_read_byte(&CLOCK_SETTINGS[speed].clock_div);
+
+    // Timer must not tick between the CPU and timer prescaler changes or the tick would be cut short.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        clock_prescale_set(clock_div);
+
+        TCCR0B = (TCCR0B & ~CLOCK_CS_MASK) | timer0_cs;
+        OCR0A = (CLOCK_TIMER0_TICK_COUNTS << new_shift) - 1;
+        OCR0B = (OCR0B >> old_shift) << new_shift;
+        // Keep the elapsed part of the current tick.
+        TCNT0 = (TCNT0 >> old_shift) << new_shift;
+
+        ADCSRA = (ADCSRA & ~CLOCK_ADPS_MASK) | adc_ps;
+
+        if (timer1_counts)
+        {
+            const uint8_t old_shift1 = pgm_read_byte(&CLOCK_SETTINGS[current_speed].timer1_shift);
+            const uint8_t new_shift1 = pgm_read_byte(&CLOCK_SETTINGS[speed].timer1_shift);
+
+            TCCR1B = (TCCR1B & ~CLOCK_CS1_MASK) | pgm_read_byte(&CLOCK_SETTINGS[speed].timer1_cs);
+            OCR1A = (timer1_counts << new_shift1) - 1;
+            TCNT1 = (TCNT1 >> old_shift1) << new_shift1;
+        }
+    }
+
+    current_speed = speed;
+    timer0_shift = new_shift;
+}
+
+/**
+ * @brief Set the Timer0 compare B point a number of counts from now, within the current tick. Kept at the same
+ *        time offset across speed changes. Points past the end of the tick are moved to its end.
+ *
+ * @param counts Counts of the slowest timer clock (64 us) from now.
+ */
+void start_clock_compare_b(const uint8_t counts)
+{
+    uint16_t at = TCNT0 + ((uint16_t)counts << timer0_shift);
+
+    if (at > OCR0A)
+        at = OCR0A;
+    OCR0B = at;
+    // A match against the previous point may already be pending.
+    TIFR0 = (1 << OCF0B);
+}
+
+/**
+ * @brief Time elapsed in the current tick. Read at the end of the tick ISR, it is the time the ISR took,
+ *        including the delay before it started.
+ *
+ * @return uint8_t Counts of the slowest timer clock (64 us), 0 to CLOCK_TIMER0_TICK_COUNTS - 1.
+ */
+uint8_t get_clock_tick_counts(void)
+{
+    return TCNT0 >> timer0_shift;
+}
+
+/**
+ * @brief Run Timer1 in CTC mode with a period that stays the same across speed changes. The caller enables
+ *        the compare interrupt.
+ *
+ * @param counts Period in counts of 125 khz (8 us), at most 32768.
+ */
+void init_clock_timer1(const uint16_t counts)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        timer1_counts = counts;
+
+        TCCR1A = 0;
+        TCCR1B = (1 << WGM12) | pgm_read_byte(&CLOCK_SETTINGS[current_speed].timer1_cs);
+        OCR1A = (counts << pgm_read_byte(&CLOCK_SETTINGS[current_speed].timer1_shift)) - 1;
+        TCNT1 = 0;
+    }
+}
+
+enum clock_speed get_clock_speed(void)
+{
+    return current_speed;
+}
@@ -0,0 +1,26 @@
+#ifndef _CLOCK_KOREY
+#define _CLOCK_KOREY
+
+#include "hardwaredefs.h"
+
+// Timer0 counts per tick at the slowest timer clock (15.625 khz). Ticks last 79 * 64us = 5.056 ms at every speed.
+#define CLOCK_TIMER0_TICK_COUNTS 79
+
+// CPU frequency at CLOCK_FAST, for cycle-counted delays in code that only runs at that speed.
+#define CLOCK_FAST_F_CPU 8000000UL
+
+// CPU speeds, fastest first. The internal oscillator runs at 8 Mhz and is divided down through CLKPR.
+enum clock_speed
+{
+    CLOCK_FAST,   // 8 Mhz, for conversion, filtering and rendering bursts
+    CLOCK_NORMAL, // 1 Mhz, the speed the chip boots at with the CKDIV8 fuse
+    CLOCK_IDLE,   // 250 khz, while waiting for the next timer tick
+};
+
+void set_clock_speed(const enum clock_speed speed);
+void start_clock_compare_b(const uint8_t counts);
+uint8_t get_clock_tick_counts(void);
+void init_clock_timer1(const uint16_t counts);
+enum clock_speed get_clock_speed(void);
+
+#endif
@@ -0,0 +1,123 @@
+#include "control.h"
+#include <stdlib.h>
+
+/**
+ * @brief Initialize controller with the relay off. Thresholds are stored but not converted, so the relay stays off
+ *        until set_controller_thresholds() is called; callers with little stack to spare can do that from a
+ *        shallower frame.
+ *
+ * @param c Controller struct
+ * @param sensor Sensor whose values are passed to update_controller()
+ * @param low_thresh Displayed temperature at or below which the relay turns on
+ * @param high_thresh Displayed temperature at or above which the relay turns off
+ */
+void init_controller(struct controller_t *c, const struct sensor_t *sensor, const int16_t low_thresh,
+                     const int16_t high_thresh)
+{
+    c->sensor = sensor;
+    c->relay = 0;
+    c->low_thresh = low_thresh;
+    c->high_thresh = high_thresh;
+    c->offset = 0;
+    c->low_value = UINT16_MAX; // No value turns the relay on
+    c->high_value = UINT16_MAX;
+}
+
+/**
+ * @brief Change thresholds and convert them to sensor values. The display truncates the measured temperature
+ *        toward zero and adds the offset, so the values are placed where the displayed degree changes: reading 32
+ *        covers 32.0 up to 33.0, and reading -5 covers -5.0 down to -6.0. Conversions cost a few milliseconds;
+ *        call this only when a threshold or the offset changed.
+ *
+ * @param c Controller struct
+ * @param low_thresh Displayed temperature at or below which the relay turns on
+ * @param high_thresh Displayed temperature at or above which the relay turns off
+ * @param offset Sensor calibration: displayed temperature minus measured temperature
+ */
+void set_controller_thresholds(struct controller_t *c, const int16_t low_thresh, const int16_t high_thresh,
+                               const int16_t offset)
+{
+    const int16_t low = low_thresh - offset;
+    const int16_t high = high_thresh - offset;
+
+    c->low_thresh = low_thresh;
+    c->high_thresh = high_thresh;
+    c->offset = offset;
+
+    // On while measuring below low + 1, or at most low below zero.
+    if (low >= 0)
+        c->low_value = sensor_temperature_to_value(c->sensor, low + 1) + 1;
+    else
+        c->low_value = sensor_temperature_to_value(c->sensor, low);
+
+    // Off while measuring at least high, or above high - 1 at zero and below.
+    if (high > 0)
+        c->high_value = sensor_temperature_to_value(c->sensor, high);
+    else
+        c->high_value = sensor_temperature_to_value(c->sensor, high - 1) - 1;
+}
+
+/**
+ * @brief Decide the relay state for a new reading. Between the thresholds the relay keeps its state.
+ *
+ * @param c Controller struct
+ * @param value Sensor value, see get_sensor_value(). Rises as temperature falls.
+ * @return uint8_t Relay state, 1 when on
+ */
+uint8_t update_controller(struct controller_t *c, const uint16_t value)
+{
+    if (value >= c->low_value)
+        c->relay = 1;
+    else if (value <= c->high_value)
+        c->relay = 0;
+
+    return c->relay;
+}
+
+/**
+ * @brief Initialize adaptive sampler.
+ *
+ * @param s Sampler struct
+ * @param min_period Shortest reading period, in timer ticks
+ * @param max_period Longest reading period, in timer ticks
+ * @param ticks_per_degree Period added per degree between the temperature and the nearest threshold
+ * @param temperature Current temperature
+ */
+void init_sampler(struct sampler_t *s, const uint16_t min_period, const uint16_t max_period,
+                  const uint8_t ticks_per_degree, const int16_t temperature)
+{
+    s->min_period = min_period;
+    s->max_period = max_period;
+    s->ticks_per_degree = ticks_per_degree;
+    s->last_temperature = temperature;
+}
+
+/**
+ * @brief Choose the period until the next temperature reading. The period grows with the distance to the
+ *        nearest threshold and is halved for every degree the temperature moved since the last reading.
+ *
+ * @param s Sampler struct
+ * @param c Controller holding the thresholds
+ * @param temperature Current (averaged) temperature
+ * @return uint16_t Ticks until the next reading, between min_period and max_period.
+ */
+uint16_t update_sampler(struct sampler_t *s, const struct controller_t *c, const int16_t temperature)
+{
+    uint16_t distance_low = abs(temperature - c->low_thresh);
+    uint16_t distance_high = abs(temperature - c->high_thresh);
+    uint16_t distance = distance_low < distance_high ? distance_low : distance_high;
+    uint16_t change = abs(temperature - s->last_temperature);
+
+    s->last_temperature = temperature;
+
+    // Compare before multiplying so large distances cannot overflow.
+    uint16_t period = s->max_period;
+    if (distance < (s->max_period - s->min_period) / s->ticks_per_degree)
+        period = s->min_period + distance * s->ticks_per_degree;
+
+    if (change >= 16)
+        change = 15;
+    period >>= change;
+
+    return period < s->min_period ? s->min_period : period;
+}
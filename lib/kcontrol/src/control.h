@@ -0,0 +1,40 @@
+#ifndef _CONTROL_KOREY
+#define _CONTROL_KOREY
+
+#include "hardwaredefs.h"
+#include "sensor.h"
+
+// Heat lamp controller: relay turns on at or below the low threshold and off at or above the high threshold.
+// Decisions compare sensor values against thresholds converted once, whenever they change.
+struct controller_t
+{
+    const struct sensor_t *sensor;
+    int16_t low_thresh;  // Degrees, for display and storage
+    int16_t high_thresh; // Degrees, for display and storage
+    int16_t offset;      // Sensor calibration, added to measured temperatures
+    uint16_t low_value;  // low_thresh as a sensor value
+    uint16_t high_value; // high_thresh as a sensor value
+    uint8_t relay;       // Current relay state, 1 when on
+};
+
+// Adaptive sampling: how often the temperature is read, in timer ticks, from the distance to the nearest
+// threshold and how fast the temperature is moving.
+struct sampler_t
+{
+    uint16_t min_period;       // Period right at a threshold or while the temperature is changing fast
+    uint16_t max_period;       // Period far from the thresholds while the temperature is stable
+    uint8_t ticks_per_degree;  // Period added per degree of distance to the nearest threshold
+    int16_t last_temperature;
+};
+
+void init_controller(struct controller_t *c, const struct sensor_t *sensor, const int16_t low_thresh,
+                     const int16_t high_thresh);
+void set_controller_thresholds(struct controller_t *c, const int16_t low_thresh, const int16_t high_thresh,
+                               const int16_t offset);
+uint8_t update_controller(struct controller_t *c, const uint16_t value);
+
+void init_sampler(struct sampler_t *s, const uint16_t min_period, const uint16_t max_period,
+                  const uint8_t ticks_per_degree, const int16_t temperature);
+uint16_t update_sampler(struct sampler_t *s, const struct controller_t *c, const int16_t temperature);
+
+#endif
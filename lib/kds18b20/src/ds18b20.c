@@ -0,0 +1,327 @@
+#include "ds18b20.h"
+#include "clock.h"
+#include <util/atomic.h>
+
+/*
+ * Single DS18B20 on its own pin, externally powered, with a 4.7k pull-up. A reading is a chain of short steps,
+ * one per main loop pass: reset, skip ROM and convert, then poll until the conversion is done, reset, skip ROM
+ * and read the scratchpad a byte at a time. Interrupts are only held off for a single bit slot (about 70 us);
+ * the reset pulse is simply the line held low until the next step.
+ */
+
+#define ONEWIRE_DELAY_US(us) __builtin_avr_delay_cycles((us) * (CLOCK_FAST_F_CPU / 1000000))
+
+#define DS18B20_SKIP_ROM 0xCC
+#define DS18B20_CONVERT 0x44
+#define DS18B20_READ_SCRATCHPAD 0xBE
+
+enum ds18b20_state
+{
+    DS18B20_IDLE,
+    DS18B20_START,           // Pull the line low to start the reset pulse
+    DS18B20_CONVERT_RESET,   // Release the line and check for a presence pulse
+    DS18B20_CONVERT_COMMAND, // Skip ROM, convert
+    DS18B20_CONVERTING,      // Poll until the sensor reads back 1
+    DS18B20_READ_START,
+    DS18B20_READ_RESET,
+    DS18B20_READ_COMMAND, // Skip ROM, read scratchpad
+    DS18B20_READ_DATA,    // Nine scratchpad bytes
+};
+
+static const uint8_t CONVERT_COMMAND[] = {DS18B20_SKIP_ROM, DS18B20_CONVERT};
+static const uint8_t READ_COMMAND[] = {DS18B20_SKIP_ROM, DS18B20_READ_SCRATCHPAD};
+
+static void onewire_low(struct ds18b20_t *d)
+{
+    _DDR(*d->port) |= (1 << d->pin);
+}
+
+static void onewire_release(struct ds18b20_t *d)
+{
+    _DDR(*d->port) &= ~(1 << d->pin);
+}
+
+/**
+ * @brief End the reset pulse. The line must have been low for at least 480 us.
+ *
+ * @return uint8_t 1 if a sensor answered with a presence pulse.
+ */
+static uint8_t onewire_presence(struct ds18b20_t *d)
+{
+    uint8_t present;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        onewire_release(d);
+        ONEWIRE_DELAY_US(70);
+        present = !(_PIN(*d->port) & (1 << d->pin));
+    }
+    // Presence pulse is over long before the next step.
+
+    return present;
+}
+
+static void onewire_write_byte(struct ds18b20_t *d, uint8_t byte)
+{
+    for (uint8_t i = 0; i < 8; i++, byte >>= 1)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            onewire_low(d);
+            if (byte & 1)
+            {
+                ONEWIRE_DELAY_US(6);
+                onewire_release(d);
+                ONEWIRE_DELAY_US(64);
+            }
+            else
+            {
+                ONEWIRE_DELAY_US(60);
+                onewire_release(d);
+                ONEWIRE_DELAY_US(10);
+            }
+        }
+    }
+}
+
+static uint8_t onewire_read_bit(struct ds18b20_t *d)
+{
+    uint8_t bit;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        onewire_low(d);
+        ONEWIRE_DELAY_US(6);
+        onewire_release(d);
+        ONEWIRE_DELAY_US(9);
+        bit = (_PIN(*d->port) >> d->pin) & 1;
+    }
+    // Rest of the slot; running long is harmless.
+    ONEWIRE_DELAY_US(55);
+
+    return bit;
+}
+
+static uint8_t onewire_read_byte(struct ds18b20_t *d)
+{
+    uint8_t byte = 0;
+
+    for (uint8_t i = 0; i < 8; i++)
+        byte |= onewire_read_bit(d) << i;
+
+    return byte;
+}
+
+/**
+ * @brief Read the scratchpad byte at d->index. Only the temperature is kept, along with the Dallas/Maxim CRC-8
+ *        of every byte so far, which is 0 once the ninth byte matches.
+ */
+static void read_scratchpad_byte(struct ds18b20_t *d)
+{
+    const uint8_t byte = onewire_read_byte(d);
+
+    // Temperature LSB, then MSB.
+    if (d->index == 0)
+        d->reading = byte;
+    else if (d->index == 1)
+        d->reading |= (uint16_t)byte << 8;
+
+    d->crc ^= byte;
+    for (uint8_t b = 0; b < 8; b++)
+        d->crc = (d->crc & 1) ? (d->crc >> 1) ^ 0x8C : d->crc >> 1;
+}
+
+static void reading_failed(struct ds18b20_t *d)
+{
+    onewire_release(d);
+    d->state = DS18B20_IDLE;
+    if (++d->failures >= DS18B20_MAX_FAILURES)
+        d->error = 1;
+}
+
+/**
+ * @brief Initialize the sensor and take a first reading, blocking for up to a conversion time. Call at
+ *        CLOCK_FAST.
+ *
+ * @param d DS18B20 object
+ * @param port Port register of the 1-Wire pin
+ * @param pin 1-Wire pin
+ * @return uint8_t 1 if the first reading succeeded.
+ */
+uint8_t init_ds18b20(struct ds18b20_t *d, volatile uint8_t *port, const uint8_t pin)
+{
+    d->port = port;
+    d->pin = pin;
+    d->state = DS18B20_IDLE;
+    d->failures = 0;
+    d->error = 0;
+    d->raw = 0;
+
+    // Low whenever driven, released otherwise.
+    *port &= ~(1 << pin);
+    onewire_release(d);
+
+    read_ds18b20(d);
+    while (!d->error)
+    {
+        if (step_ds18b20(d))
+            return 1;
+        ONEWIRE_DELAY_US(5056); // One timer tick, as DS18B20_CONVERSION_STEPS assumes
+        if (d->state == DS18B20_IDLE)
+            read_ds18b20(d); // Retry until DS18B20_MAX_FAILURES
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start a conversion on the next step, unless one is in progress.
+ *
+ * @param d DS18B20 object
+ * @return uint8_t Always 0, the reading completes through step_ds18b20().
+ */
+uint8_t read_ds18b20(struct ds18b20_t *d)
+{
+    if (d->state == DS18B20_IDLE)
+        d->state = DS18B20_START;
+
+    return 0;
+}
+
+/**
+ * @brief Advance the reading by one step. Call once per timer tick at CLOCK_FAST: the bit slots are
+ *        cycle-counted for that speed, and consecutive calls must be at least 480 us apart.
+ *
+ * @param d DS18B20 object
+ * @return uint8_t 1 when a new reading is available.
+ */
+uint8_t step_ds18b20(struct ds18b20_t *d)
+{
+    switch (d->state)
+    {
+    case DS18B20_START:
+    case DS18B20_READ_START:
+        onewire_low(d);
+        d->state++;
+        break;
+
+    case DS18B20_CONVERT_RESET:
+    case DS18B20_READ_RESET:
+        if (!onewire_presence(d))
+        {
+            reading_failed(d);
+            break;
+        }
+        d->index = 0;
+        d->state++;
+        break;
+
+    case DS18B20_CONVERT_COMMAND:
+        onewire_write_byte(d, CONVERT_COMMAND[d->index++]);
+        if (d->index == sizeof(CONVERT_COMMAND))
+        {
+            d->index = 0;
+            d->state = DS18B20_CONVERTING;
+        }
+        break;
+
+    case DS18B20_CONVERTING:
+        if (onewire_read_bit(d))
+            d->state = DS18B20_READ_START;
+        else if (++d->index >= DS18B20_CONVERSION_STEPS)
+            reading_failed(d);
+        break;
+
+    case DS18B20_READ_COMMAND:
+        onewire_write_byte(d, READ_COMMAND[d->index++]);
+        if (d->index == sizeof(READ_COMMAND))
+        {
+            d->index = 0;
+            d->crc = 0;
+            d->state = DS18B20_READ_DATA;
+        }
+        break;
+
+    case DS18B20_READ_DATA:
+        read_scratchpad_byte(d);
+        if (++d->index < DS18B20_SCRATCHPAD_SIZE)
+            break;
+
+        // An open line reads all ones, which fails the CRC as well.
+        if (d->crc != 0)
+        {
+            reading_failed(d);
+            break;
+        }
+        const int16_t raw = d->reading;
+
+        // A sensor that lost power since the conversion was started reports its power-on value. Only believe
+        // 85 C when the previous reading was close to it, which it never is on the first conversion.
+        if (raw == DS18B20_POWER_ON_RAW && d->raw < DS18B20_POWER_ON_RAW - 16)
+        {
+            reading_failed(d);
+            break;
+        }
+        d->raw = raw;
+        d->failures = 0;
+        d->error = 0;
+        d->state = DS18B20_IDLE;
+        return 1;
+
+    default:
+    case DS18B20_IDLE:
+        break;
+    }
+
+    return 0;
+}
+
+static uint8_t ds18b20_read(void *device)
+{
+    return read_ds18b20(device);
+}
+
+static uint8_t ds18b20_step(void *device)
+{
+    return step_ds18b20(device);
+}
+
+static float ds18b20_temperature(const void *device)
+{
+    float temperature = ((const struct ds18b20_t *)device)->raw / 16.0;
+
+#if TEMPERATURE_SCALE == FAHRENHEIT
+    temperature = temperature * 9.0 / 5.0 + 32.0;
+#endif
+
+    return temperature;
+}
+
+static uint16_t ds18b20_value(const void *device)
+{
+    return DS18B20_VALUE_OFFSET - ((const struct ds18b20_t *)device)->raw;
+}
+
+static uint16_t ds18b20_temperature_to_value(const void *device, const int16_t temperature)
+{
+    int32_t raw = temperature;
+
+#if TEMPERATURE_SCALE == FAHRENHEIT
+    // Degrees fahrenheit to 1/16 degree celsius, rounded up to the first raw reading at the temperature.
+    // Division truncates toward zero, which already rounds up below zero.
+    raw = (raw - 32) * 80;
+    raw = raw > 0 ? (raw + 8) / 9 : raw / 9;
+#else
+    raw *= 16;
+#endif
+
+    return DS18B20_VALUE_OFFSET - raw;
+}
+
+static uint8_t ds18b20_error(const void *device)
+{
+    return ((const struct ds18b20_t *)device)->error;
+}
+
+const struct sensor_ops_t DS18B20_SENSOR PROGMEM =
+    {ds18b20_read, ds18b20_step, ds18b20_temperature, ds18b20_value, ds18b20_temperature_to_value, ds18b20_error};
@@ -0,0 +1,34 @@
+#ifndef _DS18B20_KOREY
+#define _DS18B20_KOREY
+
+#include "hardwaredefs.h"
+#include "sensor.h"
+
+// 12 bit readings, 1/16 degree celsius, converted in up to 750 ms.
+#define DS18B20_MAX_FAILURES 3        // Consecutive failed readings before the sensor is in error, until a good one
+#define DS18B20_CONVERSION_STEPS 250  // Steps to wait for a conversion, 1.26 s at one step per tick
+#define DS18B20_VALUE_OFFSET 0x8000U  // Controller value is this minus the raw reading
+#define DS18B20_POWER_ON_RAW 0x0550   // 85 C, what the scratchpad holds until the first conversion completes
+#define DS18B20_SCRATCHPAD_SIZE 9     // Bytes, the last one a CRC of the others
+
+struct ds18b20_t
+{
+    volatile uint8_t *port;
+    uint8_t pin;
+    uint8_t state;
+    uint8_t index;       // Byte within the current command or scratchpad, or steps spent converting
+    uint8_t failures;    // Consecutive failed readings
+    uint8_t error;
+    int16_t raw;         // Latest valid reading, 1/16 degree celsius, 0 before the first
+    int16_t reading;     // Temperature bytes of the scratchpad being read
+    uint8_t crc;         // CRC of the scratchpad bytes read so far
+};
+
+// Device is a struct ds18b20_t.
+extern const struct sensor_ops_t DS18B20_SENSOR PROGMEM;
+
+uint8_t init_ds18b20(struct ds18b20_t *d, volatile uint8_t *port, const uint8_t pin);
+uint8_t read_ds18b20(struct ds18b20_t *d);
+uint8_t step_ds18b20(struct ds18b20_t *d);
+
+#endif
@@ -0,0 +1,59 @@
+#include "loop.h"
+
+/**
+ * @brief Initialize the control loop from the sensor's first reading. The first reading after this one is
+ *        TIME_TEMP_READING ticks after tick 0.
+ *
+ * @param l Control loop struct
+ * @param s Sensor, already holding a reading
+ * @param c Controller holding the thresholds and offset
+ * @param min_period Shortest reading period, TIME_TEMP_READING_MIN unless simulating a fixed period
+ * @param max_period Longest reading period, TIME_TEMP_READING_MAX unless simulating a fixed period
+ */
+void init_control_loop(struct control_loop_t *l, const struct sensor_t *s, const struct controller_t *c,
+                       const uint16_t min_period, const uint16_t max_period)
+{
+    l->temperature = get_sensor_temperature(s);
+    l->period = TIME_TEMP_READING;
+    l->last_reading = 0;
+    init_sampler(&l->sampler, min_period, max_period, TIME_TEMP_READING_PER_DEGREE, l->temperature + c->offset);
+}
+
+/**
+ * @brief One main loop pass, once per timer tick: advance the sensor, start a reading when one is due, and decide
+ *        the relay, which is left in c->relay. A sensor in error keeps the relay off while readings go on.
+ *
+ * @param l Control loop struct
+ * @param s Sensor
+ * @param c Controller
+ * @param now Timer tick count, wrapping
+ * @return uint8_t 1 when a reading completed on this pass.
+ */
+uint8_t step_control_loop(struct control_loop_t *l, struct sensor_t *s, struct controller_t *c, const uint16_t now)
+{
+    // Slow sensors advance once per pass.
+    uint8_t reading_done = step_sensor(s);
+
+    if ((uint16_t)(now - l->last_reading) >= l->period)
+    {
+        l->last_reading = now;
+        reading_done |= read_sensor(s);
+    }
+
+    if (reading_done)
+    {
+        // Converted once per reading rather than every pass.
+        l->temperature = get_sensor_temperature(s);
+
+        // Read sooner near a threshold or while the temperature is moving, less often otherwise.
+        l->period = update_sampler(&l->sampler, c, l->temperature + c->offset);
+    }
+
+    // Start from off once readings are good again.
+    if (get_sensor_error(s))
+        c->relay = 0;
+    else
+        update_controller(c, get_sensor_value(s));
+
+    return reading_done;
+}
@@ -0,0 +1,40 @@
+#ifndef _LOOP_KOREY
+#define _LOOP_KOREY
+
+#include "hardwaredefs.h"
+#include "control.h"
+#include "sensor.h"
+
+// Shared by src/main.c and the host tools, so a simulation runs the same pass as the firmware.
+
+// Timer tick, 79 counts of 64 us (see lib/kclock/src/clock.h). Periods below are in ticks.
+#define LOOP_TICK_SECONDS 0.005056
+#define TIME_SECOND 198                 // 1 / LOOP_TICK_SECONDS
+#define TIME_TEMP_READING 400           // 2 s, until the adaptive sampler takes over
+#define TIME_TEMP_READING_MIN 100       // 0.5 s, at a threshold or while temperature moves fast
+#define TIME_TEMP_READING_MAX 1200      // 6 s, far from the thresholds and stable
+#define TIME_TEMP_READING_PER_DEGREE 40 // 0.2 s per degree from the nearest threshold
+
+#define TEMP_LOW_DEFAULT 32
+#define TEMP_HIGH_DEFAULT 65
+
+// NTC thermistor on the sensor pin, with its series resistor to VCC.
+#define THERMISTOR_BCOEFFICIENT 3950
+#define THERMISTOR_SERIES_RESISTOR 10000
+#define THERMISTOR_RESISTANCE_NOMINAL 10000
+#define THERMISTOR_TEMP_NOMINAL 25
+
+// Reading schedule and latest temperature of the control loop. The sensor and controller are passed in.
+struct control_loop_t
+{
+    struct sampler_t sampler;
+    uint16_t period;       // Ticks from one reading to the next
+    uint16_t last_reading; // Tick count when the last reading was started
+    int16_t temperature;   // Latest reading in degrees, without the offset
+};
+
+void init_control_loop(struct control_loop_t *l, const struct sensor_t *s, const struct controller_t *c,
+                       const uint16_t min_period, const uint16_t max_period);
+uint8_t step_control_loop(struct control_loop_t *l, struct sensor_t *s, struct controller_t *c, const uint16_t now);
+
+#endif
@@ -0,0 +1,61 @@
+#include "memstat.h"
+
+// Linker provided symbols, see avr-libc's default linker script.
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t _end;
+extern uint8_t __stack;
+
+/**
+ * @brief Paint everything between the end of .bss and the top of the stack with MEMSTAT_CANARY.
+ *        Runs from .init1, before the C runtime has set up the stack or the zero register, so it is
+ *        written in assembly and never called directly.
+ */
+void paint_stack(void) __attribute__((naked, used, section(".init1")));
+void paint_stack(void)
+{
+    __asm volatile("    ldi r30, lo8(_end)\n"
+                   "    ldi r31, hi8(_end)\n"
+                   "    ldi r24, %0\n"
+                   "    ldi r25, hi8(__stack)\n"
+                   "    rjmp 2f\n"
+                   "1:  st Z+, r24\n"
+                   "2:  cpi r30, lo8(__stack)\n"
+                   "    cpc r31, r25\n"
+                   "    brlo 1b\n"
+                   "    breq 1b\n" ::"M"(MEMSTAT_CANARY));
+}
+
+/**
+ * @brief Count painted bytes above .bss that the stack has never overwritten.
+ *
+ * @return uint16_t Bytes of SRAM that have stayed free since reset.
+ */
+uint16_t get_stack_unused(void)
+{
+    const uint8_t *p = &_end;
+    uint16_t count = 0;
+
+    while (p <= &__stack && *p == MEMSTAT_CANARY)
+    {
+        p++;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Fill in static and peak dynamic SRAM usage.
+ *
+ * @param m Memory statistics struct
+ */
+void get_memstat(struct memstat_t *m)
+{
+    m->data_size = &__data_end - &__data_start;
+    m->bss_size = &__bss_end - &__bss_start;
+    m->free_margin = get_stack_unused();
+    m->stack_peak = (&__stack - &_end) + 1 - m->free_margin;
+}
@@ -0,0 +1,20 @@
+#ifndef _MEMSTAT_KOREY
+#define _MEMSTAT_KOREY
+
+#include "hardwaredefs.h"
+
+// Byte painted over free SRAM at reset. Any byte still holding it has never been touched by the stack.
+#define MEMSTAT_CANARY 0xC5
+
+struct memstat_t
+{
+    uint16_t data_size;   // Initialized globals (.data)
+    uint16_t bss_size;    // Zeroed globals (.bss)
+    uint16_t stack_peak;  // Deepest the stack has grown since reset
+    uint16_t free_margin; // Painted bytes never reached by the stack
+};
+
+uint16_t get_stack_unused(void);
+void get_memstat(struct memstat_t *m);
+
+#endif
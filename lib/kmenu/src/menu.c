@@ -0,0 +1,156 @@
+#include "menu.h"
+#include <avr/eeprom.h>
+
+static void read_param(const struct menu_t *m, const uint8_t index, struct menu_param_t *p)
+{
+    memcpy_P(p, &m->params[index], sizeof(*p));
+}
+
+// Just the value pointer of an entry, for bound checks, without a second entry-sized copy on the stack.
+static int16_t *read_param_value(const struct menu_t *m, const uint8_t index)
+{
+    return (int16_t *)pgm_read_ptr(&m->params[index].value);
+}
+
+/**
+ * @brief Initialize menu and load every entry with an EEPROM slot, falling back to defaults.
+ *
+ * @param m Menu struct
+ * @param params Entries, in PROGMEM
+ * @param count Number of entries
+ * @param eeprom_base EEPROM address of slot 0
+ */
+void init_menu(struct menu_t *m, const struct menu_param_t *params, const uint8_t count, uint16_t *eeprom_base)
+{
+    struct menu_param_t p;
+
+    m->params = params;
+    m->count = count;
+    m->current = MENU_CLOSED;
+    m->eeprom_base = eeprom_base;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        read_param(m, i, &p);
+        if (p.eeprom_slot == MENU_NONE)
+            continue;
+
+        uint16_t stored = eeprom_read_word(&eeprom_base[p.eeprom_slot]);
+        if (stored <= (uint16_t)(p.max - p.min))
+            *p.value = p.min + stored;
+        else
+            *p.value = p.default_value;
+    }
+
+    // Entries loaded independently may violate each other's bounds; fall back to defaults for both.
+    for (uint8_t i = 0; i < count; i++)
+    {
+        read_param(m, i, &p);
+        if (p.upper_bound == MENU_NONE)
+            continue;
+
+        int16_t *bound = read_param_value(m, p.upper_bound);
+        if (*p.value >= *bound)
+        {
+            *p.value = p.default_value;
+            *bound = pgm_read_word(&params[p.upper_bound].default_value);
+        }
+    }
+}
+
+/**
+ * @brief Open the menu at the first entry, or move to the next one, wrapping around.
+ *
+ * @param m Menu struct
+ */
+void next_menu_item(struct menu_t *m)
+{
+    if (m->current == MENU_CLOSED || m->current + 1 >= m->count)
+        m->current = 0;
+    else
+        m->current++;
+}
+
+void close_menu(struct menu_t *m)
+{
+    m->current = MENU_CLOSED;
+}
+
+/**
+ * @brief Change the shown entry by a number of steps, keeping it within its range and bounds.
+ *
+ * @param m Menu struct
+ * @param steps Encoder increments, negative to decrease
+ * @return uint8_t 1 if the value changed.
+ */
+uint8_t adjust_menu_item(struct menu_t *m, const int8_t steps)
+{
+    struct menu_param_t p;
+
+    if (m->current == MENU_CLOSED || steps == 0)
+        return 0;
+
+    read_param(m, m->current, &p);
+    if (p.step == 0)
+        return 0;
+
+    int16_t min = p.min;
+    int16_t max = p.max;
+    if (p.lower_bound != MENU_NONE)
+    {
+        const int16_t bound = *read_param_value(m, p.lower_bound);
+        if (bound + 1 > min)
+            min = bound + 1;
+    }
+    if (p.upper_bound != MENU_NONE)
+    {
+        const int16_t bound = *read_param_value(m, p.upper_bound);
+        if (bound - 1 < max)
+            max = bound - 1;
+    }
+
+    int16_t value = *p.value + steps * p.step;
+    if (value < min || value > max)
+        return 0;
+
+    *p.value = value;
+    return 1;
+}
+
+/**
+ * @brief Show the current entry.
+ *
+ * @param m Menu struct
+ * @param td Display
+ */
+void render_menu(const struct menu_t *m, struct sevseg_display_t *td)
+{
+    struct menu_param_t p;
+
+    if (m->current == MENU_CLOSED)
+        return;
+
+    read_param(m, m->current, &p);
+    set_display_number(td, *p.value, p.format);
+    if (p.label)
+        set_digit(td, 0, p.label, 0);
+    if (p.decimal != MENU_NONE)
+        set_decimal(td, p.decimal);
+}
+
+/**
+ * @brief Write every entry with an EEPROM slot. Only changed bytes are written.
+ *
+ * @param m Menu struct
+ */
+void save_menu(const struct menu_t *m)
+{
+    struct menu_param_t p;
+
+    for (uint8_t i = 0; i < m->count; i++)
+    {
+        read_param(m, i, &p);
+        if (p.eeprom_slot != MENU_NONE)
+            eeprom_update_word(&m->eeprom_base[p.eeprom_slot], *p.value - p.min);
+    }
+}
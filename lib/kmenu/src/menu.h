@@ -0,0 +1,42 @@
+#ifndef _MENU_KOREY
+#define _MENU_KOREY
+
+#include "hardwaredefs.h"
+#include "sevensegment.h"
+
+#define MENU_CLOSED 0xFF // menu_t.current while the menu is not shown
+#define MENU_NONE 0xFF   // No decimal point, bound or EEPROM slot
+
+// Menu entry, stored in flash. Values are stored in EEPROM as the distance from min, so erased EEPROM
+// (0xFFFF) is out of range for every entry and loads the default.
+struct menu_param_t
+{
+    int16_t *value;
+    int16_t min;
+    int16_t max;
+    int16_t default_value;
+    uint8_t step;        // 0 for read-only (diagnostic) entries
+    uint8_t format;      // SEVSEG_FMT_* flags for set_display_number()
+    char label;          // Shown on the leftmost digit, 0 for none
+    uint8_t decimal;     // Display buffer index of the decimal point marking this entry, or MENU_NONE
+    uint8_t lower_bound; // Index of the entry this value must stay above, or MENU_NONE
+    uint8_t upper_bound; // Index of the entry this value must stay below, or MENU_NONE
+    uint8_t eeprom_slot; // Word offset from the menu's EEPROM base, or MENU_NONE
+};
+
+struct menu_t
+{
+    const struct menu_param_t *params; // In flash
+    uint8_t count;
+    uint8_t current; // Index of the shown entry, or MENU_CLOSED
+    uint16_t *eeprom_base;
+};
+
+void init_menu(struct menu_t *m, const struct menu_param_t *params, const uint8_t count, uint16_t *eeprom_base);
+void next_menu_item(struct menu_t *m);
+void close_menu(struct menu_t *m);
+uint8_t adjust_menu_item(struct menu_t *m, const int8_t steps);
+void render_menu(const struct menu_t *m, struct sevseg_display_t *td);
+void save_menu(const struct menu_t *m);
+
+#endif
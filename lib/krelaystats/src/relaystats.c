@@ -0,0 +1,139 @@
+#include "relaystats.h"
+#include <avr/eeprom.h>
+#include <stddef.h>
+
+static uint8_t get_record_checksum(const struct relay_record_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint8_t sum = 0x6D; // Erased EEPROM (all 0xFF) must not pass. Changed with the record layout.
+
+    for (uint8_t i = 0; i < offsetof(struct relay_record_t, checksum); i++)
+        sum = (sum << 1 | sum >> 7) ^ p[i];
+
+    return sum;
+}
+
+/**
+ * @brief Initialize relay statistics, restoring counters from the newest valid EEPROM record.
+ *
+ * @param rs Relay statistics struct
+ * @param eeprom_slots EEPROM address of two consecutive records
+ * @param ticks_per_second Timer ticks per second
+ */
+void init_relay_stats(struct relay_stats_t *rs, struct relay_record_t *eeprom_slots, const uint8_t ticks_per_second)
+{
+    struct relay_record_t record;
+    uint8_t found = 0;
+
+    rs->slots = eeprom_slots;
+    rs->ticks_per_second = ticks_per_second;
+    rs->ticks = 0;
+    rs->on_ticks = 0;
+    rs->last_tick = 0;
+    rs->relay = 0;
+    rs->sequence = 0;
+    rs->unsaved_seconds = 0;
+    rs->counters = (struct relay_counters_t){0};
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        eeprom_read_block(&record, &eeprom_slots[i], sizeof(record));
+        if (record.checksum != get_record_checksum(&record))
+            continue;
+
+        // Sequence numbers wrap around; the newer one is less than half the range ahead.
+        if (!found || (int8_t)(record.sequence - rs->sequence) > 0)
+        {
+            rs->sequence = record.sequence;
+            rs->counters = record.counters;
+            found = 1;
+        }
+    }
+
+    // The relay starts off, so the first off period starts now.
+    rs->run_start = rs->counters.total_seconds;
+}
+
+/**
+ * @brief Account the timer ticks since the last call. Called from the main loop rather than the timer ISR, which
+ *        it would lengthen; the relay state only changes there anyway.
+ *
+ * @param rs Relay statistics struct
+ * @param relay Relay state since the last call, 1 when on
+ * @param now Timer tick count, wrapping
+ */
+void tick_relay_stats(struct relay_stats_t *rs, const uint8_t relay, const uint16_t now)
+{
+    struct relay_counters_t *c = &rs->counters;
+
+    if (relay != rs->relay)
+    {
+        rs->relay = relay;
+        rs->run_start = c->total_seconds;
+        c->switches++;
+    }
+
+    // Usually one tick, more after a long main loop pass.
+    for (; rs->last_tick != now; rs->last_tick++)
+    {
+        if (relay && ++rs->on_ticks == rs->ticks_per_second)
+        {
+            rs->on_ticks = 0;
+            c->on_seconds++;
+        }
+
+        if (++rs->ticks < rs->ticks_per_second)
+            continue;
+
+        rs->ticks = 0;
+        c->total_seconds++;
+        rs->unsaved_seconds++;
+    }
+
+    // Divides only when the current period passes the longest by a minute.
+    const uint32_t seconds = c->total_seconds - rs->run_start;
+    uint16_t *longest = relay ? &c->longest_on : &c->longest_off;
+    if (*longest < UINT16_MAX && seconds >= (*longest + 1UL) * 60)
+        *longest = seconds / 60 < UINT16_MAX ? seconds / 60 : UINT16_MAX;
+}
+
+/**
+ * @brief Copy the counters.
+ *
+ * @param rs Relay statistics struct
+ * @param counters Output
+ */
+void get_relay_counters(const struct relay_stats_t *rs, struct relay_counters_t *counters)
+{
+    *counters = rs->counters;
+}
+
+/**
+ * @brief Seconds since the counters were last saved, so the caller can decide when to save without copying them.
+ *
+ * @param rs Relay statistics struct
+ * @return uint16_t
+ */
+uint16_t get_relay_unsaved_seconds(const struct relay_stats_t *rs)
+{
+    return rs->unsaved_seconds;
+}
+
+/**
+ * @brief Write the counters to the EEPROM slot not holding the newest record. Takes several milliseconds,
+ *        so call it rarely and outside of interrupts.
+ *
+ * @param rs Relay statistics struct
+ */
+void save_relay_stats(struct relay_stats_t *rs)
+{
+    struct relay_record_t record;
+
+    record.counters = rs->counters;
+    rs->unsaved_seconds = 0;
+    record.sequence = rs->sequence + 1;
+    record.checksum = get_record_checksum(&record);
+
+    eeprom_update_block(&record, &rs->slots[record.sequence & 1], sizeof(record));
+    rs->sequence = record.sequence;
+}
@@ -0,0 +1,45 @@
+#ifndef _RELAY_STATS_KOREY
+#define _RELAY_STATS_KOREY
+
+#include "hardwaredefs.h"
+
+// Relay usage. Seconds rather than timer ticks, so the totals last well beyond the life of the relay. On time
+// is still counted to the tick; the fraction of a second is carried in RAM.
+struct relay_counters_t
+{
+    uint32_t total_seconds;
+    uint32_t on_seconds;
+    uint32_t switches;    // Off to on and on to off
+    uint16_t longest_on;  // Longest continuous on period, in minutes, at most 45 days
+    uint16_t longest_off; // Longest continuous off period, in minutes, at most 45 days
+};
+
+// Stored in two alternating EEPROM slots, so a reset during a write leaves the previous record intact.
+struct relay_record_t
+{
+    uint8_t sequence; // Incremented with every save, the newer valid slot wins
+    struct relay_counters_t counters;
+    uint8_t checksum;
+};
+
+struct relay_stats_t
+{
+    struct relay_counters_t counters;
+    uint8_t ticks_per_second;
+    uint8_t ticks;            // Ticks into the current second
+    uint8_t on_ticks;         // On ticks not yet counted in on_seconds
+    uint16_t last_tick;       // Timer tick count at the last tick_relay_stats()
+    uint8_t relay;            // Relay state at the last tick_relay_stats()
+    uint32_t run_start;       // total_seconds when the relay last switched
+    uint8_t sequence;         // Sequence number of the last saved record
+    uint16_t unsaved_seconds; // Seconds counted since the last save
+    struct relay_record_t *slots; // Two consecutive records in EEPROM
+};
+
+void init_relay_stats(struct relay_stats_t *rs, struct relay_record_t *eeprom_slots, const uint8_t ticks_per_second);
+void tick_relay_stats(struct relay_stats_t *rs, const uint8_t relay, const uint16_t now);
+void get_relay_counters(const struct relay_stats_t *rs, struct relay_counters_t *counters);
+uint16_t get_relay_unsaved_seconds(const struct relay_stats_t *rs);
+void save_relay_stats(struct relay_stats_t *rs);
+
+#endif
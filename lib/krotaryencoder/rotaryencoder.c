@@ -18,9 +18,9 @@
 void init_rotary_encoder(struct rotary_encoder_t *re, volatile uint8_t *port, const uint8_t sw, const uint8_t dt, const uint8_t clk)
 {
     re->port = port;
-    re->pin_sw = sw;
-    re->pin_dt = dt;
-    re->pin_clk = clk;
+    re->mask_sw = 1 << sw;
+    re->mask_dt = 1 << dt;
+    re->mask_clk = 1 << clk;
 
     // Data direction: input
     _DDR(*port) &= ~(1 << sw);  // Input SW
@@ -41,20 +41,23 @@ void init_rotary_encoder(struct rotary_encoder_t *re, volatile uint8_t *port, co
  */
 uint8_t get_rotenc_status(struct rotary_encoder_t *re)
 {
-    return !!(_PIN(*re->port) & (1 << re->pin_sw)) << 2 |
-           !!((_PIN(*re->port) & (1 << re->pin_dt))) << 1 |
-           !!((_PIN(*re->port) & (1 << re->pin_clk)));
+    // One read, so the three bits belong together.
+    const uint8_t pins = _PIN(*re->port);
+
+    return ((pins & re->mask_sw) ? MASK_SW : 0) |
+           ((pins & re->mask_dt) ? MASK_DT : 0) |
+           ((pins & re->mask_clk) ? MASK_CLK : 0);
 }
 
 uint8_t get_rotenc_sw(struct rotary_encoder_t *re)
 {
-    return !!(_PIN(*re->port) & (1 << re->pin_sw));
+    return !!(_PIN(*re->port) & re->mask_sw);
 }
 uint8_t get_rotenc_dt(struct rotary_encoder_t *re)
 {
-    return !!(_PIN(*re->port) & (1 << re->pin_dt));
+    return !!(_PIN(*re->port) & re->mask_dt);
 }
-uint8_t get_clk(struct rotary_encoder_t *re)
+uint8_t get_rotenc_clk(struct rotary_encoder_t *re)
 {
-    return !!(_PIN(*re->port) & (1 << re->pin_clk));
+    return !!(_PIN(*re->port) & re->mask_clk);
 }
\ No newline at end of file
@@ -6,9 +6,9 @@
 struct rotary_encoder_t
 {
     volatile uint8_t *port;
-    uint8_t pin_sw;
-    uint8_t pin_dt;
-    uint8_t pin_clk;
+    uint8_t mask_sw; // Pin bit masks, read from the timer ISR
+    uint8_t mask_dt;
+    uint8_t mask_clk;
 
     volatile uint8_t status;
 };
@@ -0,0 +1,121 @@
+#include "sensor.h"
+#include "thermistor.h"
+
+#define SENSOR_OP(s, op) ((__typeof__((s)->ops->op))pgm_read_ptr(&(s)->ops->op))
+
+static uint8_t thermistor_read(void *device)
+{
+    log_temperature(device);
+    return 1;
+}
+
+static uint8_t thermistor_step(void *device)
+{
+    (void)device;
+    return 0;
+}
+
+static float thermistor_temperature(const void *device)
+{
+    return get_temperature(device);
+}
+
+static uint16_t thermistor_value(const void *device)
+{
+    return get_filtered_adc(device);
+}
+
+static uint16_t thermistor_temperature_to_value(const void *device, const int16_t temperature)
+{
+    return temperature_to_adc(device, temperature);
+}
+
+static uint8_t thermistor_error(const void *device)
+{
+    return ((const struct thermistor_t *)device)->thermistor_error;
+}
+
+const struct sensor_ops_t THERMISTOR_SENSOR PROGMEM =
+    {thermistor_read, thermistor_step, thermistor_temperature, thermistor_value, thermistor_temperature_to_value,
+     thermistor_error};
+
+/**
+ * @brief Bind a sensor driver to its device.
+ *
+ * @param s Sensor
+ * @param ops Driver table, e.g. &THERMISTOR_SENSOR
+ * @param device Initialized driver state
+ */
+void init_sensor(struct sensor_t *s, const struct sensor_ops_t *ops, void *device)
+{
+    s->ops = ops;
+    s->device = device;
+}
+
+/**
+ * @brief Start a new reading. Returns at once; slow sensors finish through step_sensor().
+ *
+ * @param s Sensor
+ * @return uint8_t 1 if the reading is already complete.
+ */
+uint8_t read_sensor(struct sensor_t *s)
+{
+    return SENSOR_OP(s, read)(s->device);
+}
+
+/**
+ * @brief Advance a reading in progress. Call once per timer tick, at CLOCK_FAST.
+ *
+ * @param s Sensor
+ * @return uint8_t 1 when a reading completed.
+ */
+uint8_t step_sensor(struct sensor_t *s)
+{
+    return SENSOR_OP(s, step)(s->device);
+}
+
+/**
+ * @brief Temperature of the latest reading, in the scale set by TEMPERATURE_SCALE.
+ *
+ * @param s Sensor
+ * @return float
+ */
+float get_sensor_temperature(const struct sensor_t *s)
+{
+    return SENSOR_OP(s, temperature)(s->device);
+}
+
+/**
+ * @brief Latest reading in the sensor's own units, for update_controller(). Rises as temperature falls.
+ *
+ * @param s Sensor
+ * @return uint16_t
+ */
+uint16_t get_sensor_value(const struct sensor_t *s)
+{
+    return SENSOR_OP(s, value)(s->device);
+}
+
+/**
+ * @brief Largest value (see get_sensor_value()) at which the sensor reads a temperature or warmer.
+ *
+ * @param s Sensor
+ * @param temperature Temperature in the scale set by TEMPERATURE_SCALE
+ * @return uint16_t
+ */
+uint16_t sensor_temperature_to_value(const struct sensor_t *s, const int16_t temperature)
+{
+    return SENSOR_OP(s, temperature_to_value)(s->device, temperature);
+}
+
+/**
+ * @brief Nonzero while the sensor is disconnected, shorted or otherwise not to be trusted. A thermistor error
+ *        stays until reset; a DS18B20 clears it with its next good reading.
+ *
+ * @param s Sensor
+ * @return uint8_t
+ */
+uint8_t get_sensor_error(const struct sensor_t *s)
+{
+    return SENSOR_OP(s, error)(s->device);
+}
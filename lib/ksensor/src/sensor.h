@@ -0,0 +1,39 @@
+#ifndef _SENSOR_KOREY
+#define _SENSOR_KOREY
+
+#include "hardwaredefs.h"
+
+// Set temperature scale to be used, by every sensor.
+#define FAHRENHEIT 0
+#define CELSIUS 1
+#define TEMPERATURE_SCALE FAHRENHEIT
+
+// What the control loop needs from a temperature sensor. Each driver provides one table, kept in flash.
+struct sensor_ops_t
+{
+    uint8_t (*read)(void *device);  // Start a reading, 1 if it completed already
+    uint8_t (*step)(void *device);  // Advance a reading in progress, 1 when it completes
+    float (*temperature)(const void *device);
+    uint16_t (*value)(const void *device); // Controller value, rises as temperature falls
+    uint16_t (*temperature_to_value)(const void *device, const int16_t temperature); // Largest value reading it or warmer
+    uint8_t (*error)(const void *device);
+};
+
+struct sensor_t
+{
+    const struct sensor_ops_t *ops; // In PROGMEM
+    void *device;
+};
+
+// Analog NTC thermistor, device is a struct thermistor_t.
+extern const struct sensor_ops_t THERMISTOR_SENSOR PROGMEM;
+
+void init_sensor(struct sensor_t *s, const struct sensor_ops_t *ops, void *device);
+uint8_t read_sensor(struct sensor_t *s);
+uint8_t step_sensor(struct sensor_t *s);
+float get_sensor_temperature(const struct sensor_t *s);
+uint16_t get_sensor_value(const struct sensor_t *s);
+uint16_t sensor_temperature_to_value(const struct sensor_t *s, const int16_t temperature);
+uint8_t get_sensor_error(const struct sensor_t *s);
+
+#endif
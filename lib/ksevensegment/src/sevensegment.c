@@ -21,62 +21,56 @@
  *
  */
 
-const digit_t DIGIT_TABLE[] =
-    {
-        0b11111100, // 0
-        0b01100000, // 1
-        0b11011010, // 2
-        0b11110010, // 3
-        0b01100110, // 4
-        0b10110110, // 5
-        0b10111110, // 6
-        0b11100000, // 7
-        0b11111110, // 8
-        0b11110110, // 9
-        0b11101110, // A
-        0b00111110, // B as b
-        0b10011100, // C
-        0b01111010, // D as d
-        0b10011110, // E
-        0b10001110, // F
-        0b11000110, // G, best effort
-        0b01101110, // H
-        0b00100000, // I as i
-        0b01111000, // J
-        0b01101110, // K best effort
-        0b00011100, // L
-        0b00101011, // M best effort
-        0b00101010, // N as n
-        0b11111100, // O
-        0b11001110, // P
-        0b00111011, // Q best effort
-        0b00001010, // R as r
-        0b10110111, // S best effort
-        0b01100010, // T as t
-        0b01111100, // U
-        0b01111101, // V best effort
-        0b00111000, // W best effort
-        0b01101111, // X best effort
-        0b01110110, // Y
-        0b10011110, // Z best effort
-        0b00000010, // -
-        0b11111111, // Error
-        0b00000000  // NULL
-
-        // A
-        // b
-        // C
-        // d
-        // e
-        // f
-        // g
-};
-
-static digit_t invert_display_char(digit_t c)
-{
-    // Swap 0xE0 bits with 0x1C bits, then add non-swapped bits.
-    return (((c & 0xE0) >> 3) | ((c & 0x1C) << 3) | (c & 0x3));
-}
+// Glyphs indexed by ASCII code, starting at SEVSEG_ASCII_FIRST (' '). Characters without a glyph are blank.
+// The list is expanded twice, once as is and once inverted, so both tables are built by the compiler.
+#define SEVSEG_GLYPHS(G)                                                               \
+    G(0b00000000) /*   */, G(0), G(0), G(0), G(0), G(0), G(0), G(0), /* !"#$%&' */    \
+    G(0), G(0), G(0), G(0), G(0),                                     /* ()*+, */      \
+    G(0b00000010), /* - */                                                             \
+    G(0b00000001), /* . */                                                             \
+    G(0),          /* / */                                                             \
+    G(0b11111100), /* 0 */                                                             \
+    G(0b01100000), /* 1 */                                                             \
+    G(0b11011010), /* 2 */                                                             \
+    G(0b11110010), /* 3 */                                                             \
+    G(0b01100110), /* 4 */                                                             \
+    G(0b10110110), /* 5 */                                                             \
+    G(0b10111110), /* 6 */                                                             \
+    G(0b11100000), /* 7 */                                                             \
+    G(0b11111110), /* 8 */                                                             \
+    G(0b11110110), /* 9 */                                                             \
+    G(0), G(0), G(0), G(0), G(0), G(0), G(0), /* :;<=>?@ */                            \
+    G(0b11101110), /* A */                                                             \
+    G(0b00111110), /* B as b */                                                        \
+    G(0b10011100), /* C */                                                             \
+    G(0b01111010), /* D as d */                                                        \
+    G(0b10011110), /* E */                                                             \
+    G(0b10001110), /* F */                                                             \
+    G(0b11000110), /* G, best effort */                                                \
+    G(0b01101110), /* H */                                                             \
+    G(0b00100000), /* I as i */                                                        \
+    G(0b01111000), /* J */                                                             \
+    G(0b01101110), /* K best effort */                                                 \
+    G(0b00011100), /* L */                                                             \
+    G(0b00101011), /* M best effort */                                                 \
+    G(0b00101010), /* N as n */                                                        \
+    G(0b00111010), /* O as o, so "LO" differs from "L0" */                             \
+    G(0b11001110), /* P */                                                             \
+    G(0b00111011), /* Q best effort */                                                 \
+    G(0b00001010), /* R as r */                                                        \
+    G(0b10110111), /* S best effort */                                                 \
+    G(0b01100010), /* T as t */                                                        \
+    G(0b01111100), /* U */                                                             \
+    G(0b01111101), /* V best effort */                                                 \
+    G(0b00111000), /* W best effort */                                                 \
+    G(0b01101111), /* X best effort */                                                 \
+    G(0b01110110), /* Y */                                                             \
+    G(0b10011110)  /* Z best effort */
+
+#define SEVSEG_GLYPH(c) (c)
+
+const digit_t DIGIT_TABLE[] PROGMEM = {SEVSEG_GLYPHS(SEVSEG_GLYPH)};
+const digit_t DIGIT_TABLE_INVERTED[] PROGMEM = {SEVSEG_GLYPHS(SEVSEG_INVERT_GLYPH)};
 
 /**
  * @brief Initialize seven segment display struct
@@ -84,7 +78,8 @@ static digit_t invert_display_char(digit_t c)
  * @param td Display struct pointer.
  * @param num_digits Number of digits in display.
  * @param port Microcontroller port. All pins must use this port.
- * @param pinmap (Pointer to) Array of pins controlling digits on/off state, in order.
+ * @param pinmap (Pointer to) Array of pins controlling digits on/off state, in order. Rewritten in place as bit
+ *               masks, so it must stay allocated and must not be shared.
  * @param digits (Pointer to) Array containing output value of each digit/segment. See DIGIT_TABLE[] above.
  * @param options Options:
  *      0x1: Invert display (upside down)
@@ -97,17 +92,21 @@ void init_sevseg(struct sevseg_display_t *td, const uint8_t num_digits,
         return;
 
     td->num_digits = num_digits;
-    td->step = (num_digits % 2 == 0) ? 3 : 2; // Mix refresh order to reduce flickering.
+    td->step = ((num_digits % 2 == 0) ? 3 : 2) % num_digits; // Mix refresh order to reduce flickering.
     td->port = port;
-    td->pin_map = pinmap;
+    td->pin_masks = pinmap;
     td->options = opts;
     td->display_buffer = digits;
+    td->glyphs = (opts & SEVSEG_OPT_INVERT) ? DIGIT_TABLE_INVERTED : DIGIT_TABLE;
+    td->current_digit = 0;
+    td->brightness = SEVSEG_BRIGHTNESS_MAX;
 
     for (uint8_t i = 0; i < num_digits; i++)
     {
-        *_DDR(td->port) |= (1 << pinmap[i]);
-        *td->port |= (1 << td->pin_map[i]);
-        td->display_buffer[i] = DIGIT_TABLE[SEVSEG_NULL];
+        pinmap[i] = 1 << pinmap[i];
+        _DDR(*td->port) |= pinmap[i];
+        *td->port |= pinmap[i];
+        td->display_buffer[i] = SEVSEG_BLANK;
     }
 }
 
@@ -122,39 +121,79 @@ void init_sevseg(struct sevseg_display_t *td, const uint8_t num_digits,
  */
 digit_t set_digit(struct sevseg_display_t *td, uint8_t index, const char c, const uint8_t decimal)
 {
-    digit_t buff = ' ';
+    // Characters outside the table wrap around to a large offset and display blank.
+    uint8_t offset = (uint8_t)c - SEVSEG_ASCII_FIRST;
+    digit_t buff = SEVSEG_BLANK;
 
-    if (c >= '0' && c <= '9')
-        buff = DIGIT_TABLE[c - '0'];
-    else if (c >= 'A' && c <= 'Z')
-        buff = DIGIT_TABLE[c - 'A' + 10];
-    else if (c == '-')
-        buff = DIGIT_TABLE[SEVSEG_MINUS];
-    else if (c == ' ')
-        buff = DIGIT_TABLE[SEVSEG_NULL];
+    if (offset <= SEVSEG_ASCII_LAST - SEVSEG_ASCII_FIRST)
+        buff = pgm_read_byte(&td->glyphs[offset]);
 
     if (td->options & SEVSEG_OPT_INVERT)
-    {
         index = td->num_digits - index - 1;
-        buff = invert_display_char(buff);
-    }
 
     td->display_buffer[index] = buff | !!decimal;
     return td->display_buffer[index];
 }
 
+/**
+ * @brief Light the next digit. Called from the timer ISR; no division or variable shifts, so it takes the same
+ *        time on every call.
+ *
+ * @param td Display
+ * @param sr Shift register driving the segments
+ */
 void setLCD_shiftreg(struct sevseg_display_t *td, struct shiftreg8_t *sr)
 {
-    // Remember last updated digit. Every ISR call updates this value.
-    static uint8_t digit_to_update = {0};
-
     // Unset the priorly set digit (does nothing on first instance if run via ISR).
-    *td->port &= ~(1 << td->pin_map[digit_to_update % td->num_digits]);
-    digit_to_update = (digit_to_update + td->step) % td->num_digits;
+    blank_sevseg(td);
 
-    shiftOut8(sr, td->display_buffer[digit_to_update]);
+    uint8_t digit = td->current_digit + td->step;
+    if (digit >= td->num_digits)
+        digit -= td->num_digits;
+    td->current_digit = digit;
 
-    *td->port |= (1 << td->pin_map[digit_to_update % td->num_digits]);
+    shiftOut8(sr, td->display_buffer[digit]);
+
+    *td->port |= td->pin_masks[digit];
+}
+
+/**
+ * @brief Turn off the digit lit by the last setLCD_shiftreg() call. Called part way through a refresh
+ *        period (e.g. from a second timer compare) to dim the display.
+ *
+ * @param td Display
+ */
+void blank_sevseg(struct sevseg_display_t *td)
+{
+    *td->port &= ~td->pin_masks[td->current_digit];
+}
+
+/**
+ * @brief Set display brightness.
+ *
+ * @param td Display
+ * @param level 1 (dimmest) to SEVSEG_BRIGHTNESS_MAX (digit lit for the whole refresh period)
+ */
+void set_brightness(struct sevseg_display_t *td, uint8_t level)
+{
+    if (level < 1)
+        level = 1;
+    else if (level > SEVSEG_BRIGHTNESS_MAX)
+        level = SEVSEG_BRIGHTNESS_MAX;
+
+    td->brightness = level;
+}
+
+/**
+ * @brief How long a digit stays lit at the current brightness, for scheduling blank_sevseg().
+ *
+ * @param td Display
+ * @param period Timer counts a digit can stay lit, from the end of setLCD_shiftreg() to the next refresh
+ * @return uint8_t Timer counts after setLCD_shiftreg() at which the digit should be blanked.
+ */
+uint8_t get_sevseg_on_counts(const struct sevseg_display_t *td, const uint8_t period)
+{
+    return ((uint16_t)period * td->brightness) / SEVSEG_BRIGHTNESS_MAX;
 }
 
 /**
@@ -203,48 +242,139 @@ void set_display_float(struct sevseg_display_t *td, float f)
 */
 
 /**
- * @brief Set the display to an integer value.
+ * @brief Convert to packed BCD with the double dabble algorithm, avoiding software division.
  *
- * @param td
- * @param n
+ * @param n Value to convert
+ * @param bcd Output, least significant digit pair first, two digits per byte.
  */
+static void bin_to_bcd(uint16_t n, uint8_t bcd[SEVSEG_FMT_BYTES])
+{
+    for (uint8_t b = 0; b < SEVSEG_FMT_BYTES; b++)
+        bcd[b] = 0;
 
-void set_display_int(struct sevseg_display_t *td, int n)
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        // Add 3 to every digit of 5 or more so that shifting left carries it into the next digit.
+        for (uint8_t b = 0; b < SEVSEG_FMT_BYTES; b++)
+        {
+            if ((bcd[b] & 0x0F) >= 0x05)
+                bcd[b] += 0x03;
+            if ((bcd[b] & 0xF0) >= 0x50)
+                bcd[b] += 0x30;
+        }
+
+        uint8_t carry = n >> 15;
+        n <<= 1;
+        for (uint8_t b = 0; b < SEVSEG_FMT_BYTES; b++)
+        {
+            uint8_t next = bcd[b] >> 7;
+            bcd[b] = (bcd[b] << 1) | carry;
+            carry = next;
+        }
+    }
+}
+
+static uint8_t get_nibble(const uint8_t bcd[SEVSEG_FMT_BYTES], const uint8_t k)
+{
+    if (k >= SEVSEG_FMT_BYTES * 2)
+        return 0;
+
+    return (k & 1) ? bcd[k >> 1] >> 4 : bcd[k >> 1] & 0x0F;
+}
+
+/**
+ * @brief Set the display to a number.
+ *
+ * @param td Display
+ * @param n Value. With SEVSEG_FMT_DECIMALS(d), the value in units of 10^-d (e.g. 125 with one decimal is 12.5).
+ * @param format SEVSEG_FMT_* flags, 0 for a right aligned integer without leading zeroes.
+ *      SEVSEG_FMT_LEFT: Left align
+ *      SEVSEG_FMT_ZERO_PAD: Fill the display with leading zeroes (right aligned only)
+ *      SEVSEG_FMT_HEX: Hexadecimal, n taken as unsigned
+ *      SEVSEG_FMT_OVF_DASH: Show dashes instead of "Hi"/"Lo" when the value does not fit
+ *      SEVSEG_FMT_DECIMALS(d): Fixed point with d digits after the decimal point
+ */
+void set_display_number(struct sevseg_display_t *td, const int16_t n, const uint8_t format)
 {
-    uint8_t r = 0;
+    const uint8_t decimals = SEVSEG_FMT_GET_DECIMALS(format);
+    uint8_t bcd[SEVSEG_FMT_BYTES];
     uint8_t is_neg = 0;
+    uint16_t u = n;
+    uint8_t len;
 
-    if (n < 0)
+    if (format & SEVSEG_FMT_HEX)
     {
-        n *= -1;
-        set_digit(td, 0, '-', 0);
-        is_neg = 1;
+        bcd[0] = u & 0xFF;
+        bcd[1] = u >> 8;
+        bcd[2] = 0;
+        len = 4;
     }
-
-    // As leftmost digit is element 0, we start from the last digit and work our way to zero.
-    // If negative, we reserve 0 for the negative sign(.
-    // Exit loop once the number is fully displayed to avoid leading zeroes.
-    int8_t i = td->num_digits - 1;
-    for (; i >= is_neg && n > 0; i--)
+    else
     {
-        r = n % 10;
-        n /= 10;
-
-        set_digit(td, i, r + '0', 0);
+        if (n < 0)
+        {
+            is_neg = 1;
+            u = -u;
+        }
+        bin_to_bcd(u, bcd);
+        len = 5;
     }
 
-    if (i == td->num_digits - 1)
+    // Drop leading zeroes, keeping at least one digit before the decimal point, which may need zeroes that
+    // double dabble did not produce (e.g. 5 with three decimals is 0.005).
+    if (len < decimals + 1)
+        len = decimals + 1;
+    while (len > decimals + 1 && get_nibble(bcd, len - 1) == 0)
+        len--;
+
+    uint8_t width = len + is_neg;
+    if (width > td->num_digits)
     {
-        set_digit(td, i, '0', 0);
-        i--;
+        for (uint8_t i = 0; i < td->num_digits; i++)
+        {
+            char c = ' ';
+            if (format & SEVSEG_FMT_OVF_DASH)
+                c = '-';
+            else if (i == td->num_digits - 2)
+                c = is_neg ? 'L' : 'H';
+            else if (i == td->num_digits - 1)
+                c = is_neg ? 'O' : 'I';
+            set_digit(td, i, c, 0);
+        }
+        return;
     }
-    // Clear unused digits (e.g. remove 3rd digit if temperature goes from 101 to 99).
-    for (; i >= is_neg; i--)
+
+    if ((format & (SEVSEG_FMT_ZERO_PAD | SEVSEG_FMT_LEFT)) == SEVSEG_FMT_ZERO_PAD)
+        width = td->num_digits;
+
+    const uint8_t start = (format & SEVSEG_FMT_LEFT) ? 0 : td->num_digits - width;
+    for (uint8_t i = 0; i < td->num_digits; i++)
     {
-        set_digit(td, i, ' ', 0);
+        if (i < start || i >= start + width)
+            set_digit(td, i, ' ', 0);
+        else if (is_neg && i == start)
+            set_digit(td, i, '-', 0);
+        else
+        {
+            // Digit position counted from the least significant digit.
+            uint8_t k = start + width - 1 - i;
+            uint8_t d = get_nibble(bcd, k);
+            // Upside down, a digit's decimal point sits at its top left, so it goes on the digit after it.
+            uint8_t point = (td->options & SEVSEG_OPT_INVERT) ? k + 1 == decimals : k == decimals;
+            set_digit(td, i, d < 10 ? '0' + d : 'A' + d - 10, decimals && point);
+        }
     }
+}
 
-    // Note that if the display does not have enough digits than the most significant digits may not show up.
+/**
+ * @brief Set the display to an integer value, right aligned.
+ *
+ * @param td
+ * @param n
+ */
+void set_display_int(struct sevseg_display_t *td, int n)
+{
+    set_display_number(td, n, 0);
 }
 
 /**
@@ -279,7 +409,7 @@ void invert_display(struct sevseg_display_t *td)
 {
     for (uint8_t i = 0; i < td->num_digits; i++)
     {
-        td->display_buffer[i] = (((td->display_buffer[i] & 0xE0) >> 3) | ((td->display_buffer[i] & 0x1C) << 3) | (td->display_buffer[i] & 0x3));
+        td->display_buffer[i] = SEVSEG_INVERT_GLYPH(td->display_buffer[i]);
 
         /*
         buffer = td->display_buffer[i];
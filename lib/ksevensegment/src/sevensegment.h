@@ -4,31 +4,59 @@
 #include "shiftregister.h"
 
 #define SEVSEG_DECIMAL 0x1
-#define SEVSEG_MINUS 36
-#define SEVSEG_ERROR_INDEX 37
-#define SEVSEG_NULL 38
+#define SEVSEG_BLANK 0x0
+#define SEVSEG_ERROR 0xFF // All segments lit
+
+// Range of ASCII characters covered by the glyph tables.
+#define SEVSEG_ASCII_FIRST ' '
+#define SEVSEG_ASCII_LAST 'Z'
+
+// Swap segments a, b, c with d, e, f (display mounted upside down); g and dp stay in place.
+#define SEVSEG_INVERT_GLYPH(c) ((((c) & 0xE0) >> 3) | (((c) & 0x1C) << 3) | ((c) & 0x3))
 
 #define SEVSEG_OPT_INVERT 0x1
 
+// Brightness levels, in eighths of the refresh period a digit stays lit.
+#define SEVSEG_BRIGHTNESS_MAX 8
+
+// Format flags for set_display_number()
+#define SEVSEG_FMT_LEFT 0x1
+#define SEVSEG_FMT_ZERO_PAD 0x2
+#define SEVSEG_FMT_HEX 0x4
+#define SEVSEG_FMT_OVF_DASH 0x8
+#define SEVSEG_FMT_DECIMALS(d) ((d) << 4)
+#define SEVSEG_FMT_GET_DECIMALS(format) (((format) >> 4) & 0x7)
+
+// Bytes of packed BCD needed for a 16-bit value (five digits) or four hex digits.
+#define SEVSEG_FMT_BYTES 3
+
 typedef uint8_t digit_t;
 
 struct sevseg_display_t
 {
     uint8_t num_digits; // Total amount of digits on display
-    uint8_t step;       // Step for ISR calls (e.g. a step of 2 will refresh digits in 0, 2, 4, 6 (modulus num_digits) order)
+    uint8_t step;       // Step for ISR calls, less than num_digits (e.g. a step of 2 will refresh digits in 0, 2, 4, 6 (modulus num_digits) order)
     volatile uint8_t *port;
-    uint8_t *pin_map;
+    uint8_t *pin_masks;     // Digit pin bit masks, converted in place from the pin map passed to init_sevseg()
     digit_t *display_buffer;
+    const digit_t *glyphs; // Glyph table in flash, already inverted if SEVSEG_OPT_INVERT is set
     uint8_t options;
+    uint8_t current_digit; // Digit lit by the last refresh
+    uint8_t brightness;    // 1 to SEVSEG_BRIGHTNESS_MAX
 };
 
 void init_sevseg(struct sevseg_display_t *, const uint8_t num_digits, volatile uint8_t *port, uint8_t * pinmap, const uint8_t opts, digit_t *digits);
 
 digit_t set_digit(struct sevseg_display_t *td, uint8_t index, const char c, const uint8_t decimal);
+void set_display_number(struct sevseg_display_t *td, const int16_t n, const uint8_t format);
 void set_display_int(struct sevseg_display_t *td, int n);
 void set_display(struct sevseg_display_t *td, char *word, const uint8_t len);
 
 void setLCD_shiftreg(struct sevseg_display_t *td, struct shiftreg8_t *sr);
+void blank_sevseg(struct sevseg_display_t *td);
+
+void set_brightness(struct sevseg_display_t *td, uint8_t level);
+uint8_t get_sevseg_on_counts(const struct sevseg_display_t *td, const uint8_t period);
 
 void set_decimal(struct sevseg_display_t *td, const uint8_t n);
 void unset_decimal(struct sevseg_display_t *td, const uint8_t n);
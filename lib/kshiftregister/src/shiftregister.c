@@ -13,38 +13,40 @@ void init_shiftreg8(struct shiftreg8_t *sr, volatile uint8_t *port, const uint8_
                     const uint8_t pin_clock, const uint8_t pin_data)
 {
     sr->port = port;
-    sr->pin_latch = pin_latch;
-    sr->pin_clock = pin_clock;
-    sr->pin_data = pin_data;
+    sr->mask_latch = 1 << pin_latch;
+    sr->mask_clock = 1 << pin_clock;
+    sr->mask_data = 1 << pin_data;
 
     // Enable data direction enable to output.
     _DDR(*port) |= (1 << pin_data) | (1 << pin_clock) | (1 << pin_latch);
 }
 
 /**
- * @brief Apply value to shift register
+ * @brief Apply value to shift register. Runs in the timer ISR, so the port is read once and then only written,
+ *        taking the same time for every value. Other bits of the port must not change from an interrupt
+ *        while this runs.
  *
  * @param sr Shift register struct containing port and pins
  * @param val Byte mapping for shit register
  */
 void shiftOut8(struct shiftreg8_t *sr, const uint8_t val)
 {
-    // Turn latch on, to high.
-    *sr->port &= ~(1 << sr->pin_latch);
+    volatile uint8_t *port = sr->port;
+    const uint8_t data = sr->mask_data;
+    const uint8_t clock = sr->mask_clock;
 
-    // Set data pin to val
-    for (uint8_t i = 0; i < 8; i++)
-    {
-        if (val & (1 << i))
-            *sr->port |= 1 << sr->pin_data;
-        else
-            *sr->port &= ~(1 << sr->pin_data);
+    // Latch, clock and data low.
+    const uint8_t out = *port & ~(sr->mask_latch | clock | data);
+    *port = out;
 
-        // Pulse clock pin per bit
-        *sr->port |= (1 << sr->pin_clock);
-        *sr->port &= ~(1 << sr->pin_clock);
+    // Set data pin to val, then pulse the clock pin per bit. The next bit's write brings the clock low.
+    for (uint8_t bit = 1; bit; bit <<= 1)
+    {
+        const uint8_t level = (val & bit) ? out | data : out;
+        *port = level;
+        *port = level | clock;
     }
 
-    // Set latch off, to low.
-    *sr->port |= (1 << sr->pin_latch);
+    // Clock low, latch high.
+    *port = out | sr->mask_latch;
 }
\ No newline at end of file
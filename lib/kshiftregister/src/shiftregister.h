@@ -6,9 +6,9 @@
 struct shiftreg8_t
 {
     volatile uint8_t *port; // Pins must be on same port
-    uint8_t pin_latch;
-    uint8_t pin_clock;
-    uint8_t pin_data;
+    uint8_t mask_latch;     // Pin bit masks, so shifting out needs no variable shifts
+    uint8_t mask_clock;
+    uint8_t mask_data;
 };
 
 void init_shiftreg8(struct shiftreg8_t *sr, volatile uint8_t *port, const uint8_t pin_latch,
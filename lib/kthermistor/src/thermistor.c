@@ -1,32 +1,27 @@
 #include "thermistor.h"
 #include "math.h"
 #include "hardwaredefs.h"
-#include <avr/io.h>
-#include <avr/common.h>
 
 #define THERMISTOR_READ_ERROR_THRESHOLD 25
+#define KELVIN_OFFSET 273.15
+
 /**
- * @brief Return temperature reading from a thermistor in fahrenheit.
- * @todo Refactor if celsius needed
+ * @brief Read the thermistor's ADC pin NOISE_REDUCTION_SMOOTHING_READINGS times.
  *
  * @param t Thermistor object
- * @return float
+ * @return uint16_t Sum of the readings.
  */
-static float get_thermistor_temperature(struct thermistor_t *t)
+static uint16_t read_thermistor_adc(struct thermistor_t *t)
 {
-    // A simplified version of the Steinhart-Hart equation.
-    // int temps[NOISE_REDUCTION_SMOOTHING_READINGS];
-    float average = 0;
+    uint16_t sum = 0;
 
     for (uint8_t i = 0; i < NOISE_REDUCTION_SMOOTHING_READINGS; i++)
     {
-        // temps[i] = adc(t->pin);
-        average += adc(t->pin); // temps[i];
+        sum += adc(t->pin);
 
         for (uint8_t t = 0; t < THERMISTOR_READING_CYCLES_DELAY; t++)
             ;
     }
-    average /= NOISE_REDUCTION_SMOOTHING_READINGS;
 
     // If we get a reading within error threshold, set error status.
     // Prevent on/off functionality on bad readings or if thermistor goes bad.
@@ -34,9 +29,24 @@ static float get_thermistor_temperature(struct thermistor_t *t)
     // the chickens by turning the heat lamp on by default!
     // Might be more efficient with PTC thermistors. TODO.
     // NOTE: Tested only with NTC thermistor!
-    if (average <= THERMISTOR_READ_ERROR_THRESHOLD || average >= ADC_MAX - THERMISTOR_READ_ERROR_THRESHOLD)
+    if (sum <= THERMISTOR_READ_ERROR_THRESHOLD * NOISE_REDUCTION_SMOOTHING_READINGS ||
+        sum >= (ADC_MAX - THERMISTOR_READ_ERROR_THRESHOLD) * NOISE_REDUCTION_SMOOTHING_READINGS)
         t->thermistor_error = 1;
 
+    return sum;
+}
+
+/**
+ * @brief Convert an averaged ADC reading to temperature in fahrenheit.
+ * @todo Refactor if celsius needed
+ *
+ * @param t Thermistor object
+ * @param average Averaged ADC reading
+ * @return float
+ */
+static float adc_to_temperature(const struct thermistor_t *t, float average)
+{
+    // A simplified version of the Steinhart-Hart equation.
     average = t->series_resistor / (ADC_MAX / average - 1);
     // b-parameter equation:
     // (1 / T) = (1 / To) + ln(R/Ro)
@@ -46,9 +56,8 @@ static float get_thermistor_temperature(struct thermistor_t *t)
     // Ro = Resistance nominal (of thermistor at temperature nominal)
 
     average = average / t->resistance_nominal;
-    average = log(average) / t->bcoefficient + (1 / (t->temperature_nominal + 273.15));
-    // average = (log(average) * 1000) / t->bcoefficient / 1000 + (1 / ((t->temperature_nominal + 27315) / 100));
-    average = (1 / average - 273.15);
+    average = log(average) / t->bcoefficient + (1 / (t->temperature_nominal + KELVIN_OFFSET));
+    average = (1 / average - KELVIN_OFFSET);
 
 #if TEMPERATURE_SCALE == FAHRENHEIT
     average = (average * 9.0) / 5.0 + 32.0;
@@ -56,15 +65,13 @@ static float get_thermistor_temperature(struct thermistor_t *t)
 
     return average;
 }
+
 /**
- * @brief Obtain temperature readings for the thermistor.
- * @return float
+ * @brief Initialize thermistor and start its filter from the average of THERMISTOR_FILTER_READINGS readings.
  */
-
 void init_thermistor(struct thermistor_t *t, volatile uint8_t *port, const uint8_t pin, const uint16_t bcoefficient,
                      const uint16_t series_resistor, const uint16_t resistance_nominal, const int8_t temp_nominal)
 {
-    t->port = port;
     t->pin = pin;
     t->bcoefficient = bcoefficient;
     t->series_resistor = series_resistor;
@@ -72,11 +79,10 @@ void init_thermistor(struct thermistor_t *t, volatile uint8_t *port, const uint8
     t->temperature_nominal = temp_nominal;
     t->thermistor_error = 0;
 
-    t->index = 0;
-    // init_temperature(t);
-    for (uint8_t i = 0; i < THERMISTOR_TEMPERATURE_SAMPLES; i++)
+    t->filtered_adc = 0;
+    for (uint8_t i = 0; i < THERMISTOR_FILTER_READINGS; i++)
     {
-        t->temperatures[i] = get_thermistor_temperature(t);
+        t->filtered_adc += read_thermistor_adc(t);
         for (uint8_t t = 0; t < THERMISTOR_READING_CYCLES_DELAY; t++)
             ;
     }
@@ -84,33 +90,65 @@ void init_thermistor(struct thermistor_t *t, volatile uint8_t *port, const uint8
 }
 
 /**
- * @brief Initialize thermistor struct's internal temperature log (for smoothing readings)
+ * @brief Take a new reading and fold it into the filter with a weight of 1 / THERMISTOR_FILTER_READINGS.
  *
  * @param t
  */
-/*
-static void init_temperature(struct thermistor_t *t)
+void log_temperature(struct thermistor_t *t)
 {
-    for (uint8_t i = 0; i < THERMISTOR_TEMPERATURE_SAMPLES; i++)
-    {
-        t->temperatures[i] = get_temperature(t);
-        for (uint8_t t = 0; t < THERMISTOR_READING_CYCLES_DELAY; t++)
-            ;
-    }
+    const uint16_t reading = read_thermistor_adc(t);
+
+    t->filtered_adc += reading - t->filtered_adc / THERMISTOR_FILTER_READINGS;
 }
-*/
 
-void log_temperature(struct thermistor_t *t)
+/**
+ * @brief Filtered ADC value: THERMISTOR_ADC_SCALE times the average raw sample.
+ *        Rises as temperature falls (NTC thermistor on the ground side of the divider).
+ *
+ * @param t
+ * @return uint16_t
+ */
+uint16_t get_filtered_adc(const struct thermistor_t *t)
 {
-    t->temperatures[t->index++ % THERMISTOR_TEMPERATURE_SAMPLES] = get_thermistor_temperature(t);
+    return t->filtered_adc;
 }
 
+/**
+ * @brief Temperature at the filtered ADC value.
+ *
+ * @param t
+ * @return float
+ */
 float get_temperature(const struct thermistor_t *t)
 {
-    float temp_avg = 0;
+    return adc_to_temperature(t, (float)t->filtered_adc / THERMISTOR_ADC_SCALE);
+}
+
+/**
+ * @brief Largest filtered ADC value (see get_filtered_adc()) at which the thermistor reads a temperature or
+ *        warmer. Found by bisecting adc_to_temperature() (16 steps), so exp() is not linked into the firmware just
+ *        for threshold changes.
+ *
+ * @param t
+ * @param temperature Temperature in fahrenheit
+ * @return uint16_t
+ */
+uint16_t temperature_to_adc(const struct thermistor_t *t, const int16_t temperature)
+{
+    // Rail readings are left out: they would divide by zero.
+    uint16_t low = 1;
+    uint16_t high = ADC_MAX * THERMISTOR_ADC_SCALE - 1;
 
-    for (uint16_t i = 0; i < THERMISTOR_TEMPERATURE_SAMPLES; i++)
-        temp_avg += t->temperatures[i];
+    // Temperature falls as the reading rises.
+    while (low < high)
+    {
+        const uint16_t mid = low + (high - low + 1) / 2;
+
+        if (adc_to_temperature(t, (float)mid / THERMISTOR_ADC_SCALE) >= temperature)
+            low = mid;
+        else
+            high = mid - 1;
+    }
 
-    return temp_avg / THERMISTOR_TEMPERATURE_SAMPLES;
+    return low;
 }
@@ -0,0 +1,115 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+// Records are written one character at a time to this register. simavr prints it as console output
+// (AVR_MCU_SIMAVR_CONSOLE below); on hardware, replace trace_putc() with a software serial transmit.
+#define TRACE_REGISTER GPIOR0
+
+#include <util/atomic.h>
+
+#ifdef __AVR
+#include "avr_mcu_section.h" // From simavr, add its include directory to build_flags
+AVR_MCU(F_CPU, "attiny44");
+AVR_MCU_SIMAVR_CONSOLE(&TRACE_REGISTER);
+#endif
+
+static volatile unsigned int *trace_ticks;
+static int16_t last_low;
+static int16_t last_high;
+static int16_t last_offset;
+static uint8_t thresholds_written = 0;
+
+static void trace_putc(const char c)
+{
+    TRACE_REGISTER = c;
+}
+
+static void trace_hex(const uint16_t n)
+{
+    // Shift out nibbles instead of dividing, skipping leading zeroes.
+    uint8_t started = 0;
+
+    for (int8_t shift = 12; shift >= 0; shift -= 4)
+    {
+        uint8_t nibble = (n >> shift) & 0xF;
+        if (nibble || started || shift == 0)
+        {
+            trace_putc(nibble < 10 ? '0' + nibble : 'a' + nibble - 10);
+            started = 1;
+        }
+    }
+}
+
+static void trace_begin(const char type)
+{
+    unsigned int ticks;
+
+    // The tick counter is 16 bits and the timer ISR may increment it between the two byte reads.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = *trace_ticks;
+    }
+    trace_hex(ticks);
+    trace_putc(' ');
+    trace_putc(type);
+}
+
+/**
+ * @brief Start a trace and write its header.
+ *
+ * @param ticks Timer tick counter used to timestamp records
+ */
+void init_trace(volatile unsigned int *ticks)
+{
+    trace_ticks = ticks;
+
+    const char *header = "# ktrace ";
+    while (*header)
+        trace_putc(*header++);
+    trace_hex(TRACE_VERSION);
+    trace_putc('\n');
+}
+
+void trace_adc(const uint16_t value)
+{
+    trace_begin(TRACE_ADC);
+    trace_putc(' ');
+    trace_hex(value);
+    trace_putc('\n');
+}
+
+void trace_event(const char type)
+{
+    trace_begin(type);
+    trace_putc('\n');
+}
+
+/**
+ * @brief Record the temperature thresholds and sensor offset if they differ from the last recorded ones.
+ *
+ * @param low Low threshold
+ * @param high High threshold
+ * @param offset Sensor offset
+ */
+void trace_thresholds(const int16_t low, const int16_t high, const int16_t offset)
+{
+    if (thresholds_written && low == last_low && high == last_high && offset == last_offset)
+        return;
+
+    last_low = low;
+    last_high = high;
+    last_offset = offset;
+    thresholds_written = 1;
+
+    trace_begin(TRACE_THRESHOLDS);
+    trace_putc(' ');
+    trace_hex(low);
+    trace_putc(' ');
+    trace_hex(high);
+    trace_putc(' ');
+    trace_hex(offset);
+    trace_putc('\n');
+}
+
+#endif
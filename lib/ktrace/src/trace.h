@@ -0,0 +1,47 @@
+#ifndef _TRACE_KOREY
+#define _TRACE_KOREY
+
+#include "hardwaredefs.h"
+
+/*
+ * Trace recording for offline replay (see tools/replay). Enable with -DTRACE_ENABLE=1 in build_flags.
+ *
+ * A trace is plain text, one record per line, with numbers in hexadecimal:
+ *
+ *   # ktrace 1            Header, written once at reset
+ *   <tick> A <adc>        Raw ADC sample, in the order the firmware read them
+ *   <tick> B              Rotary encoder button press
+ *   <tick> L              Rotary encoder turned counterclockwise
+ *   <tick> R              Rotary encoder turned clockwise
+ *   <tick> S <low> <high> <offset>
+ *                         Temperature thresholds and sensor offset, written at reset and whenever they change
+ *
+ * <tick> is the 16-bit timer tick counter and wraps around, <low>, <high> and <offset> are 16-bit two's
+ * complement.
+ */
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+#define TRACE_VERSION 1
+
+#define TRACE_ADC 'A'
+#define TRACE_BUTTON 'B'
+#define TRACE_CCW 'L'
+#define TRACE_CW 'R'
+#define TRACE_THRESHOLDS 'S'
+
+#if TRACE_ENABLE
+void init_trace(volatile unsigned int *ticks);
+void trace_adc(const uint16_t value);
+void trace_event(const char type);
+void trace_thresholds(const int16_t low, const int16_t high, const int16_t offset);
+#else
+#define init_trace(ticks)
+#define trace_adc(value)
+#define trace_event(type)
+#define trace_thresholds(low, high, offset)
+#endif
+
+#endif
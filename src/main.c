@@ -1,28 +1,70 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
 
 #include "rotaryencoder.h"
 #include "shiftregister.h"
 #include "thermistor.h"
+#include "ds18b20.h"
+#include "sensor.h"
 #include "sevensegment.h"
+#include "memstat.h"
+#include "clock.h"
+#include "control.h"
+#include "loop.h"
+#include "trace.h"
+#include "relaystats.h"
+#include "menu.h"
+#include "bus.h"
 
 #define RELAY_PORT PORTA
 #define RELAY_PIN PA7
 #define TEMPERATURE_SCALE FAHRENHEIT
 
-#define EEPROM_LOW_ADDY (uint16_t *)10
-#define EEPROM_HIGH_ADDY (uint16_t *)20
+// Read a DS18B20 on the thermistor's pin (PA6) instead of the thermistor. Needs a 4.7k pull-up to VCC.
+#ifndef SENSOR_DS18B20
+#define SENSOR_DS18B20 0
+#endif
+#define SENSOR_PORT PORTA
+#define SENSOR_PIN PA6
+
+#define EEPROM_SETTINGS_ADDY (uint16_t *)32 // Menu entries, one word per slot
+#define EEPROM_RELAY_STATS_ADDY (struct relay_record_t *)64 // Two slots
 #define TEMP_MIN -50
 #define TEMP_MAX 150
-#define TEMP_LOW_DEFAULT 32
-#define TEMP_HIGH_DEFAULT 65
-
-// How often every time OCR0A is reached
-#define TIMER_INTERVAL 0.004992
-// Seconds desired divided by our timer interval
-#define TIME_TEMP_READING 400    // 2 / TIMER_INTERVAL
-#define TIME_ROTENC_TIMEOUT 1000 // 5 / TIMER_INTERVAL
+// Timer ticks, see lib/kloop/src/loop.h for the tick length and the temperature reading periods.
+#define TIME_ROTENC_TIMEOUT 1000     // 5 s
+#define TIME_RELAY_STATS_SAVE 3600UL // Seconds, hourly to spare EEPROM endurance
+
+// Dim the display to BRIGHTNESS_DIM after TIME_ROTENC_TIMEOUT without user input.
+#define DISPLAY_AUTO_DIM 1
+#define BRIGHTNESS_DIM 2
+// Timer counts (64 us) from the start of a tick to the moment the tick ISR lights the next digit, at most.
+// Dimmed on-times are fractions of the rest of the tick, so every level stays distinct.
+#define DISPLAY_LIT_COUNTS 16
+
+// Add diagnostic pages after the settings when cycling with the rotary encoder button.
+#define DIAGNOSTICS 1
+
+// Report to a bus master and accept threshold writes from it (see lib/kbus). Every other pin is taken, so the bus
+// needs PB3, which means setting the RSTDISBL fuse and giving up ISP programming.
+#ifndef BUS_ENABLE
+#define BUS_ENABLE 0
+#endif
+#define BUS_PORT PORTB
+#define BUS_PIN PB3
+#define BUS_PCINT_vect PCINT1_vect // PCINT0_vect for a pin on PORTA
+#define BUS_ADDRESS_DEFAULT 1
+
+// Speed between main loop passes. A bus node rests at CLOCK_NORMAL, where the tick ISR is short enough for a
+// start bit or bit sample to wait for it (see lib/kbus/src/bus.h).
+#if BUS_ENABLE
+#define RESTING_SPEED CLOCK_NORMAL
+#else
+#define RESTING_SPEED CLOCK_IDLE
+#endif
 
 #define ROT_ENC_SW PB1
 #define ROT_ENC_DT PB0
@@ -30,31 +72,92 @@
 
 static struct shiftreg8_t sr;
 static struct sevseg_display_t ss1;
+#if SENSOR_DS18B20
+static struct ds18b20_t ds1;
+#else
 static struct thermistor_t t1;
+#endif
+static struct sensor_t sensor1;
 static struct rotary_encoder_t re1;
 
-enum display_state
-{
-  DISPLAY_AMBIENT_STATE,
-  DISPLAY_HIGH_TEMP,
-  DISPLAY_LOW_TEMP
-} volatile td_state = {DISPLAY_AMBIENT_STATE};
-
 enum rot_enc_event
 {
   NONE,
   ROT_EVENT_BUTTON,
   ROT_EVENT_CCW,
   ROT_EVENT_CW,
-} volatile rot_enc_state = {NONE};
+};
+volatile static uint8_t rot_enc_state = NONE; // enum rot_enc_event, in one byte
 
 #define TEMP_LOW_MIN -50 // Fahrenheit
 #define TEMP_HIGH_MAX 200
+#define TEMP_OFFSET_MAX 9 // Sensor calibration, either way
 
 volatile static unsigned int overflow = 0;
-static int16_t temp_high_thresh;
-static int16_t temp_low_thresh;
-volatile static uint8_t read_temp = 0;
+static struct controller_t ctl1;
+static struct control_loop_t loop1;
+static struct relay_stats_t rs1;
+volatile static uint8_t main_tick = 0; // The main loop runs one pass per tick
+volatile static uint8_t user_idle = 0;
+static int16_t brightness;
+volatile static uint8_t dim_counts; // Digit on-time in timer counts, 0 for full brightness
+
+// Menu entries, in the order the rotary encoder button cycles through them.
+enum menu_item
+{
+  MENU_LOW_TEMP,
+  MENU_HIGH_TEMP,
+  MENU_OFFSET,
+  MENU_BRIGHTNESS,
+#if BUS_ENABLE
+  MENU_BUS_ADDRESS,
+#endif
+#if DIAGNOSTICS
+  MENU_DIAG_STACK,       // Free SRAM margin in bytes, never reached by the stack since reset
+  MENU_DIAG_STACK_PEAK,  // Deepest the stack has grown since reset, in bytes
+  MENU_DIAG_STATIC,      // Globals (.data and .bss), in bytes
+  MENU_DIAG_DUTY,        // Relay on-time since first boot, percent with one decimal
+  MENU_DIAG_LONGEST_ON,  // Longest continuous on period since first boot, hours with one decimal
+  MENU_DIAG_LONGEST_OFF, // Longest continuous off period since first boot, hours with one decimal
+  MENU_DIAG_SWITCHES,    // Relay switch count, zero padded hexadecimal
+  MENU_DIAG_ISR,         // Longest tick ISR since reset, milliseconds with two decimals
+#endif
+  MENU_ITEMS
+};
+
+#if BUS_ENABLE
+static struct bus_t bus1;
+static int16_t bus_address;
+#endif
+
+#if DIAGNOSTICS
+static int16_t diag_value; // Value of the shown diagnostic page, see update_diagnostics()
+volatile static uint8_t isr_counts_max; // Longest tick ISR, in 64 us timer counts
+#endif
+
+static const struct menu_param_t MENU_PARAMS[MENU_ITEMS] PROGMEM =
+    {
+        // value, min, max, default, step, format, label, decimal point, above entry, below entry, EEPROM slot
+        [MENU_LOW_TEMP] = {&ctl1.low_thresh, TEMP_LOW_MIN, TEMP_HIGH_MAX, TEMP_LOW_DEFAULT, 1, 0, 0, 2, MENU_NONE, MENU_HIGH_TEMP, 0},
+        [MENU_HIGH_TEMP] = {&ctl1.high_thresh, TEMP_LOW_MIN, TEMP_HIGH_MAX, TEMP_HIGH_DEFAULT, 1, 0, 0, 0, MENU_LOW_TEMP, MENU_NONE, 1},
+        [MENU_OFFSET] = {&ctl1.offset, -TEMP_OFFSET_MAX, TEMP_OFFSET_MAX, 0, 1, 0, 'C', MENU_NONE, MENU_NONE, MENU_NONE, 2},
+        [MENU_BRIGHTNESS] = {&brightness, 1, SEVSEG_BRIGHTNESS_MAX, SEVSEG_BRIGHTNESS_MAX, 1, 0, 'B', MENU_NONE, MENU_NONE, MENU_NONE, 3},
+#if BUS_ENABLE
+        [MENU_BUS_ADDRESS] = {&bus_address, BUS_ADDRESS_MIN, BUS_ADDRESS_MAX, BUS_ADDRESS_DEFAULT, 1, 0, 'N', MENU_NONE, MENU_NONE, MENU_NONE, 4},
+#endif
+#if DIAGNOSTICS
+        [MENU_DIAG_STACK] = {&diag_value, 0, 0, 0, 0, 0, 0, 1, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_STACK_PEAK] = {&diag_value, 0, 0, 0, 0, 0, 0, 2, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_STATIC] = {&diag_value, 0, 0, 0, 0, 0, 0, 0, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_DUTY] = {&diag_value, 0, 0, 0, 0, SEVSEG_FMT_DECIMALS(1), 0, MENU_NONE, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_LONGEST_ON] = {&diag_value, 0, 0, 0, 0, SEVSEG_FMT_DECIMALS(1), 0, MENU_NONE, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_LONGEST_OFF] = {&diag_value, 0, 0, 0, 0, SEVSEG_FMT_DECIMALS(1), 0, 2, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_SWITCHES] = {&diag_value, 0, 0, 0, 0, SEVSEG_FMT_HEX | SEVSEG_FMT_ZERO_PAD, 0, MENU_NONE, MENU_NONE, MENU_NONE, MENU_NONE},
+        [MENU_DIAG_ISR] = {&diag_value, 0, 0, 0, 0, SEVSEG_FMT_DECIMALS(2), 0, MENU_NONE, MENU_NONE, MENU_NONE, MENU_NONE},
+#endif
+};
+
+static struct menu_t menu;
 
 /**
  * @brief Initialize ports and pins.
@@ -82,8 +185,8 @@ void init_timers()
   TCNT0 = 0;
   TCCR0A = (1 << WGM01);
   TCCR0B = (0 << CS02) | (1 << CS01) | (1 << CS00);
-  TIMSK0 |= (1 << OCIE0A);
-  OCR0A = 78; // 0.004992 sec with prescalar of 64 at 1 Mhz.
+  TIMSK0 |= (1 << OCIE0A); // Compare B (display dimming) is enabled by apply_brightness()
+  OCR0A = 78; // 0.004992 sec with prescalar of 64 at 1 Mhz. Retuned by set_clock_speed() at other speeds.
 
   sei();
 }
@@ -94,26 +197,26 @@ void init_timers()
  */
 ISR(TIM0_COMPA_vect)
 {
-  // Refresh display before doing anything else.
+  // Refresh display before doing anything else. Dimmed digits are blanked a fixed time after being lit,
+  // however long it took to get here at the current speed.
   setLCD_shiftreg(&ss1, &sr);
+  if (dim_counts)
+    start_clock_compare_b(dim_counts);
 
   static uint8_t rotenc_last_position = 0b11;
   static unsigned int rotenc_overflow = 0;
-  static unsigned int temperature_overflow = 0;
   // Bitmask of rotary encoder status. Three bits, SW, DT, and CLK.
   uint8_t rotenc_current = get_rotenc_status(&re1);
+  // Volatile, so read it once.
+  const unsigned int now = overflow;
 
-  // Allow temperature reading in main loop
-  if ((unsigned int)(overflow - temperature_overflow) >= TIME_TEMP_READING) // 2 Seconds
-  {
-    temperature_overflow = overflow;
-    read_temp = 1;
-  }
+  main_tick = 1;
 
   if ((rotenc_current & 0b100) == 0b000 && (rotenc_last_position & 0b100) == 0b100) // Active low
   {
     rot_enc_state = ROT_EVENT_BUTTON;
-    rotenc_overflow = overflow;
+    rotenc_overflow = now;
+    user_idle = 0;
   }
 
   // 11 -> 10; 00 -> 01 CCW
@@ -127,29 +230,183 @@ ISR(TIM0_COMPA_vect)
     else if ((rotenc_current & 0b11) == 0b10)
     {
       rot_enc_state = ROT_EVENT_CCW;
+      rotenc_overflow = now;
+      user_idle = 0;
       // CCW
     }
     else if ((rotenc_current & 0b11) == 0b01)
     {
       rot_enc_state = ROT_EVENT_CW;
+      rotenc_overflow = now;
+      user_idle = 0;
       // CW
     }
   }
   else
-    rotenc_overflow = overflow;
+  {
+    rotenc_overflow = now;
+    user_idle = 0;
+  }
 
   rotenc_last_position = rotenc_current;
 
-  // Save temperature limits to EEPROM if changed on user input timeout.
-  if (td_state != DISPLAY_AMBIENT_STATE && (unsigned int)(overflow - rotenc_overflow) >= TIME_ROTENC_TIMEOUT)
+  // User input timeout: main loop saves settings and dims the display.
+  if ((unsigned int)(now - rotenc_overflow) >= TIME_ROTENC_TIMEOUT)
+  {
+    // Latched until the next input so the overflow counter wrapping around does not undo it.
+    user_idle = 1;
+  }
+
+  overflow = now + 1;
+
+#if DIAGNOSTICS
+  // Time since the compare match: how long the CPU was kept from sleeping, at whatever speed it runs.
+  uint8_t counts = get_clock_tick_counts();
+  if (counts > isr_counts_max)
+    isr_counts_max = counts;
+#endif
+}
+
+/**
+ * @brief Timer compare B ISR, ends the current digit's on-time early to dim the display.
+ *
+ */
+ISR(TIM0_COMPB_vect)
+{
+  blank_sevseg(&ss1);
+}
+
+#if BUS_ENABLE
+/**
+ * @brief Bus start bit detection.
+ *
+ */
+ISR(BUS_PCINT_vect)
+{
+  bus_pin_change(&bus1);
+}
+
+/**
+ * @brief Bus bit timing.
+ *
+ */
+ISR(TIM1_COMPA_vect)
+{
+  bus_bit_tick(&bus1);
+}
+#endif
+
+/**
+ * @brief Set display brightness, dimming through Timer0 compare B below full brightness.
+ *
+ * @param level 1 to SEVSEG_BRIGHTNESS_MAX
+ */
+void apply_brightness(uint8_t level)
+{
+  set_brightness(&ss1, level);
+
+  if (ss1.brightness == SEVSEG_BRIGHTNESS_MAX)
+  {
+    TIMSK0 &= ~(1 << OCIE0B);
+    dim_counts = 0;
+  }
+  else
+  {
+    dim_counts = get_sevseg_on_counts(&ss1, CLOCK_TIMER0_TICK_COUNTS - DISPLAY_LIT_COUNTS);
+    TIMSK0 |= (1 << OCIE0B);
+  }
+}
+
+/**
+ * @brief Apply settings changed through the menu.
+ *
+ */
+void apply_settings()
+{
+  set_controller_thresholds(&ctl1, ctl1.low_thresh, ctl1.high_thresh, ctl1.offset);
+  trace_thresholds(ctl1.low_thresh, ctl1.high_thresh, ctl1.offset);
+}
+
+#if BUS_ENABLE
+/**
+ * @brief Answer a pending bus request. Thresholds written by the master are stored in ctl1 but not applied:
+ *        converting them goes deep into the stack, which is better done from the main loop than on top of
+ *        this frame.
+ *
+ * @param temperature Displayed temperature
+ * @param flags BUS_FLAG_* status bits
+ * @return uint8_t 1 if the master wrote new thresholds.
+ */
+uint8_t service_bus(int16_t temperature, uint8_t flags)
+{
+  if (!bus1.frame_ready)
+    return 0;
+
+  struct bus_node_t node = {bus_address, temperature, ctl1.low_thresh, ctl1.high_thresh, flags, TEMP_LOW_MIN,
+                            TEMP_HIGH_MAX, 0, 0, 0};
+  struct bus_frame_t response;
+
+  // The receive interrupt leaves the parser alone until frame_ready is cleared.
+  uint8_t reply = handle_bus_request(&node, &bus1.parser.frame, &response);
+  bus1.frame_ready = 0;
+
+  if (reply)
+    send_bus_frame(&bus1, &response);
+
+  if (!node.thresholds_requested)
+    return 0;
+
+  ctl1.low_thresh = node.requested_low;
+  ctl1.high_thresh = node.requested_high;
+  return 1;
+}
+#endif
+
+#if DIAGNOSTICS
+/**
+ * @brief Refresh the value shown on a diagnostic page. The pages share diag_value, so only the shown one is
+ *        computed.
+ *
+ * @param page Menu entry being shown
+ */
+void update_diagnostics(const uint8_t page)
+{
+  if (page <= MENU_DIAG_STATIC)
   {
-    eeprom_update_word(EEPROM_LOW_ADDY, temp_low_thresh);
-    eeprom_update_word(EEPROM_HIGH_ADDY, temp_high_thresh);
-    td_state = DISPLAY_AMBIENT_STATE;
+    struct memstat_t mem;
+
+    get_memstat(&mem);
+    if (page == MENU_DIAG_STACK)
+      diag_value = mem.free_margin;
+    else if (page == MENU_DIAG_STACK_PEAK)
+      diag_value = mem.stack_peak;
+    else
+      diag_value = mem.data_size + mem.bss_size;
   }
+  else if (page == MENU_DIAG_ISR)
+    diag_value = (isr_counts_max * 13) >> 1; // 64 us counts to 10 us, within 2%
+  else
+  {
+    struct relay_counters_t relay_counters;
 
-  overflow++;
+    get_relay_counters(&rs1, &relay_counters);
+    if (page == MENU_DIAG_DUTY)
+    {
+      diag_value = relay_counters.total_seconds ? (float)relay_counters.on_seconds * 1000 / relay_counters.total_seconds : 0;
+      if (diag_value > 999) // 100.0 does not fit on three digits
+        diag_value = 999;
+    }
+    else if (page != MENU_DIAG_SWITCHES)
+    {
+      const uint16_t minutes = page == MENU_DIAG_LONGEST_ON ? relay_counters.longest_on : relay_counters.longest_off;
+
+      diag_value = minutes < 5994 ? (minutes + 3) / 6 : 999; // Tenths of an hour; 100.0 does not fit either
+    }
+    else
+      diag_value = relay_counters.switches > 0xFFF ? 0xFFF : relay_counters.switches;
+  }
 }
+#endif
 
 /**
  * @brief Setup configuration prior to main loop.
@@ -157,11 +414,25 @@ ISR(TIM0_COMPA_vect)
  */
 void setup()
 {
+  init_trace(&overflow);
+  init_relay_stats(&rs1, EEPROM_RELAY_STATS_ADDY, TIME_SECOND);
   init_pins();
   init_timers();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+
+  // Filling the thermistor log takes a hundred readings and conversions.
+  set_clock_speed(CLOCK_FAST);
 
+#if SENSOR_DS18B20
+  // Takes the first reading, up to 750 ms.
+  init_ds18b20(&ds1, &SENSOR_PORT, SENSOR_PIN);
+  init_sensor(&sensor1, &DS18B20_SENSOR, &ds1);
+#else
   // Thermistor setup
-  init_thermistor(&t1, &PORTA, PA6, 3950, 10000, 10000, 25);
+  init_thermistor(&t1, &SENSOR_PORT, SENSOR_PIN, THERMISTOR_BCOEFFICIENT, THERMISTOR_SERIES_RESISTOR,
+                  THERMISTOR_RESISTANCE_NOMINAL, THERMISTOR_TEMP_NOMINAL);
+  init_sensor(&sensor1, &THERMISTOR_SENSOR, &t1);
+#endif
 
   // Shift register (for seven segment display)
   init_shiftreg8(&sr, &PORTA, PA3, PA4, PA5);
@@ -174,72 +445,87 @@ void setup()
        PA1,
        PA2};
 
+  // Display buffer is read by the timer ISR for the lifetime of the program, so it cannot live on the stack.
+  static digit_t digits[sizeof(sevseg_pin_map) / sizeof(sevseg_pin_map[0])];
+
   uint8_t num_digits = sizeof(sevseg_pin_map) / sizeof(sevseg_pin_map[0]);
-  uint8_t digits[num_digits];
   init_sevseg(&ss1, num_digits, &PORTA, sevseg_pin_map, SEVSEG_OPT_INVERT, digits);
 
-  // Read EEPROM for temperature values.
-  temp_low_thresh = eeprom_read_word(EEPROM_LOW_ADDY);
-  if (temp_low_thresh == 0xFFFF)
-    temp_low_thresh = TEMP_LOW_DEFAULT;
-  temp_high_thresh = eeprom_read_word(EEPROM_HIGH_ADDY);
-  if (temp_high_thresh == 0xFFFF)
-    temp_high_thresh = TEMP_HIGH_DEFAULT;
+  // Read settings from EEPROM.
+  init_controller(&ctl1, &sensor1, TEMP_LOW_DEFAULT, TEMP_HIGH_DEFAULT);
+  init_menu(&menu, MENU_PARAMS, MENU_ITEMS, EEPROM_SETTINGS_ADDY);
+  apply_brightness(brightness);
+
+#if BUS_ENABLE
+  init_bus(&bus1, &BUS_PORT, BUS_PIN);
+#endif
 }
 
 int main()
 {
   setup();
+  // Converting the thresholds and the first temperature are the deepest call chains there are; they start from
+  // main's frame, not setup's.
+  apply_settings();
+  init_control_loop(&loop1, &sensor1, &ctl1, TIME_TEMP_READING_MIN, TIME_TEMP_READING_MAX);
 
   while (1)
   {
-    // Read_temp flag from ISR routine
-    if (read_temp == 1)
-    {
-      read_temp = 0;
-      log_temperature(&t1);
-    }
+    // Everything below is one burst per timer tick: run it fast, then idle slowly until the next tick.
+    set_clock_speed(CLOCK_FAST);
 
-    // Returned averaged value (more accurate that prior log reading)
-    int16_t temperature = get_temperature(&t1);
-    if (t1.thermistor_error != 0)
+    // Relay accounting for the ticks since the last pass, which the relay spent as the last pass left it.
+    unsigned int now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-      set_digit(&ss1, 0, 'E', 0);
-      set_digit(&ss1, 1, 'R', 0);
-      set_digit(&ss1, 2, 'R', 0);
-
-      RELAY_PORT &= ~(1 << RELAY_PIN);
-      while (1)
-        ;
+      now = overflow;
     }
-    else if (temperature <= temp_low_thresh)
+    tick_relay_stats(&rs1, (RELAY_PORT >> RELAY_PIN) & 1, now);
+
+    // Readings and the relay decision, shared with tools/plantsim.
+    step_control_loop(&loop1, &sensor1, &ctl1, now);
+    if (ctl1.relay)
       RELAY_PORT |= (1 << RELAY_PIN);
-    else if (temperature >= temp_high_thresh)
+    else
       RELAY_PORT &= ~(1 << RELAY_PIN);
 
-    // Handle rotary encoder events
-    int incr = 0;
+    // A sensor in error keeps the lamp off and shows ERR while readings go on. A DS18B20 that reads again clears
+    // its error and control resumes; a thermistor error stays until reset.
+    const uint8_t sensor_error = get_sensor_error(&sensor1);
+
+    // Persist relay accounting now and then.
+    if (get_relay_unsaved_seconds(&rs1) >= TIME_RELAY_STATS_SAVE)
+      save_relay_stats(&rs1);
+
+#if BUS_ENABLE
+    uint8_t flags = ((RELAY_PORT >> RELAY_PIN) & 1) ? BUS_FLAG_RELAY : 0;
+    if (sensor_error)
+      flags |= BUS_FLAG_SENSOR_ERROR;
+    if (service_bus(loop1.temperature + ctl1.offset, flags))
+    {
+      apply_settings();
+      save_menu(&menu);
+    }
+#endif
+
+    // Handle rotary encoder events. The timeout below only closes a menu that was open before this pass.
+    const uint8_t menu_open = menu.current != MENU_CLOSED;
+    int8_t incr = 0;
     switch (rot_enc_state)
     {
     case ROT_EVENT_CCW:
-      if (td_state == DISPLAY_AMBIENT_STATE)
-        td_state = DISPLAY_LOW_TEMP;
+      trace_event(TRACE_CCW);
       incr = -1;
       break;
 
     case ROT_EVENT_CW:
-      if (td_state == DISPLAY_AMBIENT_STATE)
-        td_state = DISPLAY_LOW_TEMP;
+      trace_event(TRACE_CW);
       incr = 1;
       break;
 
     case ROT_EVENT_BUTTON:
-      if (td_state == DISPLAY_AMBIENT_STATE)
-        td_state = DISPLAY_LOW_TEMP;
-      else if (td_state == DISPLAY_LOW_TEMP)
-        td_state = DISPLAY_HIGH_TEMP;
-      else if (td_state == DISPLAY_HIGH_TEMP)
-        td_state = DISPLAY_LOW_TEMP;
+      trace_event(TRACE_BUTTON);
+      next_menu_item(&menu);
       break;
 
     default:
@@ -248,32 +534,67 @@ int main()
     }
     rot_enc_state = NONE;
 
-    // Handle display state
-    switch (td_state)
-    {
-    case DISPLAY_HIGH_TEMP:
-      if (incr && (temp_high_thresh + incr >= TEMP_LOW_MIN && temp_high_thresh + incr <= TEMP_HIGH_MAX) && temp_high_thresh + incr > temp_low_thresh)
-        temp_high_thresh += incr;
-      set_display_int(&ss1, temp_high_thresh);
-      set_decimal(&ss1, 0);
-      break;
+    // Turning the encoder opens the menu at the first entry.
+    if (incr && menu.current == MENU_CLOSED)
+      next_menu_item(&menu);
+    // Only the thresholds and the offset feed the controller; converting them takes a few milliseconds.
+    if (adjust_menu_item(&menu, incr) && menu.current <= MENU_OFFSET)
+      apply_settings();
 
-    case DISPLAY_LOW_TEMP:
-      if (incr && (temp_low_thresh + incr >= TEMP_LOW_MIN && temp_low_thresh + incr <= TEMP_HIGH_MAX) && temp_low_thresh + incr < temp_high_thresh)
-        temp_low_thresh += incr;
-      set_display_int(&ss1, temp_low_thresh);
-      set_decimal(&ss1, 2);
-      break;
+    // Save settings and return to the temperature on user input timeout.
+    if (user_idle && menu_open)
+    {
+      save_menu(&menu);
+      close_menu(&menu);
+    }
 
-    default:
-    case DISPLAY_AMBIENT_STATE:
+    // Handle display state
+    if (menu.current == MENU_CLOSED)
+    {
+      if (sensor_error)
+      {
+        set_digit(&ss1, 0, 'E', 0);
+        set_digit(&ss1, 1, 'R', 0);
+        set_digit(&ss1, 2, 'R', 0);
+      }
+      else
+        set_display_int(&ss1, loop1.temperature + ctl1.offset);
+    }
+    else
+    {
+#if DIAGNOSTICS
+      if (menu.current >= MENU_DIAG_STACK)
+        update_diagnostics(menu.current);
+#endif
+      render_menu(&menu, &ss1);
+    }
 
-      set_display_int(&ss1, temperature);
-      break;
+    // Follow the brightness setting, or dim while nobody is using the encoder.
+    uint8_t level = brightness;
+#if DISPLAY_AUTO_DIM
+    if (user_idle && level > BRIGHTNESS_DIM)
+      level = BRIGHTNESS_DIM;
+#endif
+    if (level != ss1.brightness)
+      apply_brightness(level);
+
+    // Timer ISR wakes us up for the next pass. Dimming and bus interrupts wake the CPU too; those go straight back
+    // to sleep at the resting speed. Interrupts stay off from the check to the sleep, so a tick cannot slip in
+    // between them: sleep_cpu() runs before any interrupt taken after sei().
+    set_clock_speed(RESTING_SPEED);
+    cli();
+    while (!main_tick)
+    {
+      sleep_enable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+      cli();
     }
-    incr = 0;
+    main_tick = 0;
+    sei();
   }
 
   // Should not reach here.
-  //  set_digit(&ss1, 0, SEVSEG_ERROR_INDEX, 0);
+  //  ss1.display_buffer[0] = SEVSEG_ERROR;
 }
\ No newline at end of file
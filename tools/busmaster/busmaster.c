@@ -0,0 +1,194 @@
+/*
+ * Bus master stand-in. Polls a set of simulated nodes, running the firmware's own frame parser and request
+ * handler (lib/kbus/src/busproto.c), over an in-memory wire that every node listens to, and prints the
+ * status each node reports with the time the exchange takes at the firmware's bit rate:
+ *
+ *   <address> <temperature> <low> <high> <flags> <bits> <ms>
+ *
+ * Then writes thresholds to the first node, sends a write it must refuse and a request with a corrupted
+ * byte, and prints a summary of how long a full poll of every node takes.
+ *
+ * Usage: busmaster [node count]   (default 32, at most BUS_ADDRESS_MAX)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "busproto.h"
+
+// Same as lib/kbus/src/bus.h: 8 us counts per bit.
+#define BUS_BIT_COUNTS 800
+#define BIT_MS (BUS_BIT_COUNTS * 0.008)
+#define BITS_PER_BYTE 10 // Start, eight data, stop
+// A node answers from the main loop pass that the last stop bit wakes up, well within one bit.
+#define TURNAROUND_BITS 1
+
+// Same limits as src/main.c.
+#define TEMP_LOW_MIN -50
+#define TEMP_HIGH_MAX 200
+
+struct sim_node_t
+{
+    struct bus_node_t node;
+    struct bus_parser_t parser;
+};
+
+static struct sim_node_t nodes[BUS_ADDRESS_MAX];
+static unsigned node_count;
+
+/**
+ * @brief Put bytes on the wire. Every node hears them; at most one answers.
+ *
+ * @return Number of response bytes, 0 if nobody answered.
+ */
+static uint8_t transmit(const uint8_t *request, uint8_t length, uint8_t response[BUS_FRAME_MAX])
+{
+    uint8_t response_length = 0;
+
+    for (unsigned n = 0; n < node_count; n++)
+    {
+        struct sim_node_t *s = &nodes[n];
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            if (!parse_bus_byte(&s->parser, request[i]))
+                continue;
+
+            struct bus_frame_t reply;
+            if (handle_bus_request(&s->node, &s->parser.frame, &reply))
+            {
+                if (response_length)
+                    fprintf(stderr, "bus collision from node %u\n", s->node.address);
+                response_length = encode_bus_frame(&reply, response);
+            }
+
+            // What src/main.c does with a write.
+            if (s->node.thresholds_requested)
+            {
+                s->node.thresholds_requested = 0;
+                s->node.low_thresh = s->node.requested_low;
+                s->node.high_thresh = s->node.requested_high;
+            }
+        }
+    }
+
+    return response_length;
+}
+
+static int16_t get_int16(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (uint16_t)p[1] << 8);
+}
+
+/**
+ * @brief One request and its reply.
+ *
+ * @return Bit times on the wire, or 0 if no valid reply arrived.
+ */
+static unsigned exchange(const struct bus_frame_t *request, struct bus_frame_t *reply, int corrupt)
+{
+    uint8_t buffer[BUS_FRAME_MAX];
+    uint8_t response[BUS_FRAME_MAX];
+    struct bus_parser_t parser;
+
+    uint8_t length = encode_bus_frame(request, buffer);
+    if (corrupt)
+        buffer[length - 2] ^= 0x10;
+
+    uint8_t response_length = transmit(buffer, length, response);
+    if (!response_length)
+        return 0;
+
+    init_bus_parser(&parser);
+    for (uint8_t i = 0; i < response_length; i++)
+    {
+        if (parse_bus_byte(&parser, response[i]))
+        {
+            *reply = parser.frame;
+            if (reply->address != (request->address | BUS_RESPONSE))
+                return 0;
+            return (length + response_length) * BITS_PER_BYTE + TURNAROUND_BITS;
+        }
+    }
+
+    return 0;
+}
+
+static void print_status(const struct bus_frame_t *reply, unsigned bits)
+{
+    printf("%u %d %d %d %u %u %.1f\n", reply->address & ~BUS_RESPONSE, get_int16(&reply->payload[0]),
+           get_int16(&reply->payload[2]), get_int16(&reply->payload[4]), reply->payload[6], bits, bits * BIT_MS);
+}
+
+static struct bus_frame_t thresholds_request(uint8_t address, int16_t low, int16_t high)
+{
+    struct bus_frame_t f = {address, BUS_CMD_SET_THRESHOLDS, BUS_THRESHOLDS_LENGTH, {0}};
+
+    f.payload[0] = low & 0xFF;
+    f.payload[1] = (uint16_t)low >> 8;
+    f.payload[2] = high & 0xFF;
+    f.payload[3] = (uint16_t)high >> 8;
+    return f;
+}
+
+int main(int argc, char **argv)
+{
+    node_count = argc > 1 ? atoi(argv[1]) : 32;
+    if (node_count < 1 || node_count > BUS_ADDRESS_MAX)
+    {
+        fprintf(stderr, "node count must be 1 to %d\n", BUS_ADDRESS_MAX);
+        return 1;
+    }
+
+    for (unsigned n = 0; n < node_count; n++)
+    {
+        struct bus_node_t *node = &nodes[n].node;
+
+        node->address = BUS_ADDRESS_MIN + n;
+        node->temperature = 40 + n % 30;
+        node->low_thresh = 32;
+        node->high_thresh = 65;
+        node->flags = node->temperature < 50 ? BUS_FLAG_RELAY : 0;
+        node->thresh_min = TEMP_LOW_MIN;
+        node->thresh_max = TEMP_HIGH_MAX;
+        init_bus_parser(&nodes[n].parser);
+    }
+
+    struct bus_frame_t reply;
+    unsigned poll_bits = 0;
+    unsigned worst_bits = 0;
+
+    for (unsigned n = 0; n < node_count; n++)
+    {
+        struct bus_frame_t request = {BUS_ADDRESS_MIN + n, BUS_CMD_STATUS, 0, {0}};
+        unsigned bits = exchange(&request, &reply, 0);
+
+        if (!bits)
+        {
+            printf("%u no reply\n", request.address);
+            continue;
+        }
+        print_status(&reply, bits);
+        poll_bits += bits;
+        if (bits > worst_bits)
+            worst_bits = bits;
+    }
+
+    struct bus_frame_t request = thresholds_request(BUS_ADDRESS_MIN, 40, 70);
+    unsigned bits = exchange(&request, &reply, 0);
+    printf("write 40 70: %s\n", bits && !(reply.command & BUS_NAK) ? "accepted" : "refused");
+    if (bits)
+        print_status(&reply, bits);
+
+    request = thresholds_request(BUS_ADDRESS_MIN, 70, 40);
+    bits = exchange(&request, &reply, 0);
+    printf("write 70 40: %s\n", bits && !(reply.command & BUS_NAK) ? "accepted" : "refused");
+
+    request = (struct bus_frame_t){BUS_ADDRESS_MIN, BUS_CMD_STATUS, 0, {0}};
+    bits = exchange(&request, &reply, 1);
+    printf("corrupted request: %s\n", bits ? "answered" : "ignored");
+
+    printf("%u nodes, %.1f ms per poll cycle, %.1f ms worst exchange\n", node_count, poll_bits * BIT_MS,
+           worst_bits * BIT_MS);
+
+    return 0;
+}
@@ -0,0 +1,423 @@
+/*
+ * Bit-level simulation of one bus node. Runs the firmware's software UART (lib/kbus/src/bus.c) against a
+ * simulated open-drain wire, Timer1 in CTC mode at 125 khz and the pin change interrupt, with a master that
+ * sends requests and samples replies at exact bit timing. The node's CPU runs interrupts in vector priority
+ * order, along with what else keeps it busy on the real node:
+ *
+ * - the display tick ISR (TIM0_COMPA, every 5.056 ms) for a given number of cycles. Nothing interrupts it, so a
+ *   bus interrupt that comes due meanwhile waits for it to end.
+ * - the dimming ISR (TIM0_COMPB), once per tick at a point set by the brightness
+ * - the main loop pass after each tick, which holds interrupts off for a given time (ATOMIC_BLOCK)
+ *
+ * For each run it prints
+ *
+ *   <speed> <tick ISR cycles> <interrupts off us> <worst start bit latency ms> <good exchanges>/<exchanges>
+ *
+ * An exchange is good when the reply parses and carries what the node was set to. The node's clock is off
+ * by up to +-2 %, like a calibrated internal RC oscillator.
+ *
+ * By default it runs every speed with tick ISRs of TICK_CYCLES and interrupts held off for ATOMIC_US, then
+ * searches for the longest tick ISR normal speed gets through without a failure. It exits with 1 if an exchange
+ * failed at fast or normal speed, or if normal speed takes less than twice TICK_CYCLES.
+ *
+ * Usage: bussim [exchanges] [tick ISR cycles] [interrupts off us]   (default 100; with more arguments, just print
+ *        every speed at those)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bus.h"
+
+// Worst case cycle counts of the ISRs, from the longest path through their compiled code with every loop at its
+// bound, including interrupt response, prologue and epilogue. ENTRY_CYCLES run before a bus ISR reads the pin.
+#define TICK_CYCLES 600       // TIM0_COMPA: display refresh, rotary encoder
+#define PIN_CHANGE_CYCLES 170 // PCINT1, bus_pin_change()
+#define BIT_TICK_CYCLES 490   // TIM1_COMPA, bus_bit_tick() at a stop bit, parsing the byte
+#define ENTRY_CYCLES 70
+#define DIM_CYCLES 100 // TIM0_COMPB, blank_sevseg()
+// Longest time the main loop holds interrupts off: a DS18B20 bit slot, timed for 8 Mhz, so the same at every
+// speed. Everything else is a few cycles.
+#define ATOMIC_US 80
+
+#define BIT_US (BUS_BIT_COUNTS * 8)
+#define TICK_US 5056
+#define DIM_MIN_US (16 * 64) // DISPLAY_LIT_COUNTS in src/main.c
+#define REPLY_TIMEOUT_US ((MASTER_BYTES_MAX + 1) * 10L * BIT_US)
+#define NODE_ADDRESS 7
+#define MASTER_BYTES_MAX (2 * BUS_FRAME_MAX)
+
+volatile uint8_t sim_port_a[3], sim_port_b[3];
+volatile uint8_t GIMSK, PCMSK0, PCMSK1, TIFR1, TIMSK1;
+volatile uint16_t TCNT1, OCR1A;
+
+void init_clock_timer1(const uint16_t counts)
+{
+    OCR1A = counts - 1;
+    TCNT1 = 0;
+}
+
+struct speed_t
+{
+    const char *name;
+    double mhz;
+};
+
+static const struct speed_t SPEEDS[] = {{"fast", 8}, {"normal", 1}, {"idle", 0.25}};
+
+enum handler
+{
+    HANDLER_NONE,
+    HANDLER_PIN_CHANGE,
+    HANDLER_BIT_TICK,
+};
+
+
+
+static struct bus_t bus;
+static struct bus_node_t node;
+
+// Simulated time in microseconds, and the node's state around bus.c.
+static long now;
+static double cpu_mhz;
+static long tick_phase;
+static long tick_us;     // Tick ISR length
+static uint8_t tick_flag; // TIM0_COMPA pending
+static long dim_delay;   // From the tick to the dimming ISR
+static long dim_at;      // Next dimming ISR, -1 if none
+static long atomic_us;   // Interrupts held off by the main loop pass after a tick
+static long atomic_at;   // When, -1 if not due
+static uint8_t main_pending; // The main loop runs one pass per tick; other wakes go back to sleep
+static double timer_period; // Timer1 clock period in us, 8 us give or take the node's clock error
+static double next_timer_clock;
+static uint8_t pin_change_flag;
+static uint8_t compare_flag;
+static enum handler running;
+static long handler_at; // When the running handler reads the pin
+static long busy_until;
+static uint8_t master_low;
+static uint8_t wire;
+static long start_edge; // Falling edge that starts a byte the node has not noticed yet, -1 if none
+static long worst_latency;
+
+static uint8_t wire_level(void)
+{
+    const uint8_t node_low = (_DDR(PORTB) & (1 << PB3)) && !(PORTB & (1 << PB3));
+    return !(master_low || node_low);
+}
+
+static long cycles_us(unsigned cycles)
+{
+    return (long)(cycles / cpu_mhz + 0.5);
+}
+
+/**
+ * @brief Run a handler from bus.c. Writing OCF1A to TIFR1 clears the compare flag, as on the AVR.
+ */
+static void call_handler(enum handler h)
+{
+    TIFR1 = 0;
+    if (h == HANDLER_PIN_CHANGE)
+    {
+        if (bus.state == BUS_IDLE && start_edge >= 0 && !wire)
+        {
+            if (now - start_edge > worst_latency)
+                worst_latency = now - start_edge;
+            start_edge = -1;
+        }
+        bus_pin_change(&bus);
+    }
+    else if (h == HANDLER_BIT_TICK)
+        bus_bit_tick(&bus);
+    if (TIFR1 & (1 << OCF1A))
+        compare_flag = 0;
+}
+
+/**
+ * @brief The main loop's part after a tick: answer a complete request, as service_bus() in src/main.c does.
+ */
+static void main_loop(void)
+{
+    if (!bus.frame_ready)
+        return;
+
+    struct bus_frame_t reply;
+    const uint8_t answer = handle_bus_request(&node, &bus.parser.frame, &reply);
+    bus.frame_ready = 0;
+    if (answer)
+        send_bus_frame(&bus, &reply);
+
+    if (node.thresholds_requested)
+    {
+        node.thresholds_requested = 0;
+        node.low_thresh = node.requested_low;
+        node.high_thresh = node.requested_high;
+    }
+}
+
+/**
+ * @brief Advance the node by one microsecond.
+ */
+static void step_node(void)
+{
+    const uint8_t level = wire_level();
+
+    if (level != wire)
+    {
+        if (PCMSK1 & (1 << PB3))
+            pin_change_flag = 1;
+        if (!level && bus.state == BUS_IDLE)
+            start_edge = now;
+        wire = level;
+    }
+    sim_port_b[0] = wire ? (1 << PB3) : 0;
+
+    while (next_timer_clock <= now)
+    {
+        next_timer_clock += timer_period;
+        TCNT1 = TCNT1 == OCR1A ? 0 : TCNT1 + 1;
+        if (TCNT1 == OCR1A)
+            compare_flag = 1;
+    }
+
+    if ((now - tick_phase) % TICK_US == 0)
+    {
+        tick_flag = 1;
+        dim_at = now + dim_delay;
+    }
+
+    if (running != HANDLER_NONE && now >= handler_at)
+    {
+        call_handler(running);
+        running = HANDLER_NONE;
+    }
+    if (now < busy_until)
+        return;
+
+    // Vector order: PCINT1, TIM1_COMPA, TIM0_COMPA, TIM0_COMPB.
+    if (pin_change_flag && (GIMSK & (1 << PCIE1)))
+    {
+        pin_change_flag = 0;
+        running = HANDLER_PIN_CHANGE;
+        busy_until = now + cycles_us(PIN_CHANGE_CYCLES);
+    }
+    else if (compare_flag && (TIMSK1 & (1 << OCIE1A)))
+    {
+        compare_flag = 0;
+        running = HANDLER_BIT_TICK;
+        busy_until = now + cycles_us(BIT_TICK_CYCLES);
+    }
+    else if (tick_flag)
+    {
+        tick_flag = 0;
+        main_pending = 1;
+        busy_until = now + tick_us;
+        // The main loop pass after the tick ISR holds interrupts off somewhere within its first millisecond.
+        atomic_at = busy_until + rand() % 1000;
+    }
+    else if (dim_at >= 0 && now >= dim_at)
+    {
+        dim_at = -1;
+        busy_until = now + cycles_us(DIM_CYCLES);
+    }
+    else if (atomic_at >= 0 && now >= atomic_at)
+    {
+        atomic_at = -1;
+        busy_until = now + atomic_us;
+    }
+    else if (main_pending)
+    {
+        main_pending = 0;
+        main_loop();
+    }
+    handler_at = now + cycles_us(ENTRY_CYCLES);
+}
+
+/**
+ * @brief Master side of one exchange: send a request at exact bit timing, then sample the reply in the middle
+ *        of each bit.
+ *
+ * @return 1 if a reply for the request arrived, with the frame in reply.
+ */
+static uint8_t exchange(const struct bus_frame_t *request, struct bus_frame_t *reply)
+{
+    uint8_t buffer[BUS_FRAME_MAX];
+    const uint8_t length = encode_bus_frame(request, buffer);
+    const long bits = length * 10L;
+
+    for (long bit = 0; bit < bits; bit++)
+    {
+        const uint8_t byte = buffer[bit / 10];
+        const int position = bit % 10;
+
+        if (position == 0)
+            master_low = 1;
+        else if (position == 9)
+            master_low = 0;
+        else
+            master_low = !((byte >> (position - 1)) & 1);
+
+        for (long end = now + BIT_US; now < end; now++)
+            step_node();
+    }
+    master_low = 0;
+
+    struct bus_parser_t parser;
+    init_bus_parser(&parser);
+    uint8_t received = 0;
+
+    for (const long end = now + REPLY_TIMEOUT_US; now < end && received < MASTER_BYTES_MAX;)
+    {
+        step_node();
+        now++;
+        if (wire)
+            continue;
+
+        // Start bit: sample each bit in its middle.
+        const long start = now - 1;
+        uint8_t byte = 0;
+        for (int position = 1; position <= 9; position++)
+        {
+            while (now < start + BIT_US / 2 + position * BIT_US)
+            {
+                step_node();
+                now++;
+            }
+            if (position == 9)
+            {
+                if (!wire) // Framing error
+                    return 0;
+            }
+            else
+                byte |= wire << (position - 1);
+        }
+        received++;
+
+        if (parse_bus_byte(&parser, byte))
+        {
+            *reply = parser.frame;
+            return reply->address == (request->address | BUS_RESPONSE);
+        }
+    }
+
+    return 0;
+}
+
+static int16_t get_int16(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (uint16_t)p[1] << 8);
+}
+
+static void idle(long us)
+{
+    for (const long end = now + us; now < end; now++)
+        step_node();
+}
+
+static unsigned run(const struct speed_t *speed, unsigned tick_cycles, long interrupts_off_us, unsigned exchanges)
+{
+    srand(1);
+    cpu_mhz = speed->mhz;
+    tick_us = cycles_us(tick_cycles);
+    atomic_us = interrupts_off_us;
+    worst_latency = 0;
+    start_edge = -1;
+
+    unsigned good = 0;
+    for (unsigned e = 0; e < exchanges; e++)
+    {
+        // A fresh node every few exchanges, with its own clock error and tick phase. The others check that a
+        // node takes the next request after replying.
+        if (e % 4 == 0)
+        {
+            timer_period = 8.0 * (1 + (rand() % 401 - 200) / 10000.0);
+            tick_phase = now + rand() % TICK_US;
+            dim_delay = DIM_MIN_US + rand() % (TICK_US - DIM_MIN_US);
+            tick_flag = main_pending = 0;
+            dim_at = atomic_at = -1;
+            next_timer_clock = now;
+            running = HANDLER_NONE;
+            busy_until = now;
+            pin_change_flag = compare_flag = 0;
+            master_low = 0;
+            wire = 1;
+            init_bus(&bus, &PORTB, PB3);
+        }
+
+        node.address = NODE_ADDRESS;
+        node.temperature = rand() % 150 - 20;
+        node.low_thresh = 30;
+        node.high_thresh = 60;
+        node.flags = e & 1 ? BUS_FLAG_RELAY : 0;
+        node.thresh_min = -50;
+        node.thresh_max = 200;
+
+        // Let the master's first start bit land anywhere within the tick, after the gap a node needs to finish
+        // its last stop bit (see lib/kbus/src/bus.h).
+        idle(BUS_TURNAROUND_BITS * BIT_US + rand() % (2 * TICK_US));
+
+        struct bus_frame_t request = {NODE_ADDRESS, BUS_CMD_STATUS, 0, {0}};
+        int16_t low = node.low_thresh;
+        int16_t high = node.high_thresh;
+        if (e % 3 == 2)
+        {
+            low = rand() % 50;
+            high = low + 1 + rand() % 100;
+            request.command = BUS_CMD_SET_THRESHOLDS;
+            request.length = BUS_THRESHOLDS_LENGTH;
+            request.payload[0] = low & 0xFF;
+            request.payload[1] = (uint16_t)low >> 8;
+            request.payload[2] = high & 0xFF;
+            request.payload[3] = (uint16_t)high >> 8;
+        }
+
+        struct bus_frame_t reply;
+        if (exchange(&request, &reply) && reply.command == request.command &&
+            get_int16(&reply.payload[0]) == node.temperature && get_int16(&reply.payload[2]) == low &&
+            get_int16(&reply.payload[4]) == high && reply.payload[6] == node.flags)
+            good++;
+    }
+
+    printf("%s %u %ld %.2f %u/%u\n", speed->name, tick_cycles, atomic_us, worst_latency / 1000.0, good,
+           exchanges);
+    return good;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned exchanges = argc > 1 ? atoi(argv[1]) : 100;
+    const struct speed_t *normal = &SPEEDS[1];
+
+    if (argc > 2)
+    {
+        const unsigned tick_cycles = atoi(argv[2]);
+        const long interrupts_off_us = argc > 3 ? atol(argv[3]) : ATOMIC_US;
+        for (unsigned s = 0; s < sizeof(SPEEDS) / sizeof(SPEEDS[0]); s++)
+            run(&SPEEDS[s], tick_cycles, interrupts_off_us, exchanges);
+        return 0;
+    }
+
+    int failed = 0;
+    for (unsigned s = 0; s < sizeof(SPEEDS) / sizeof(SPEEDS[0]); s++)
+        if (run(&SPEEDS[s], TICK_CYCLES, ATOMIC_US, exchanges) < exchanges && SPEEDS[s].mhz >= normal->mhz)
+            failed = 1;
+
+    // Longest tick ISR at normal speed without a failure, to 10 cycles. It has to end before the next tick.
+    unsigned low = 0;
+    unsigned high = TICK_US * normal->mhz / 10;
+    while (high - low > 1)
+    {
+        const unsigned mid = (low + high) / 2;
+        if (run(normal, mid * 10, ATOMIC_US, exchanges) == exchanges)
+            low = mid;
+        else
+            high = mid;
+    }
+    printf("normal speed takes tick ISRs of up to %u cycles, %.1f times the worst case of %d\n", low * 10,
+           low * 10.0 / TICK_CYCLES, TICK_CYCLES);
+    if (low * 10 < 2 * TICK_CYCLES)
+        failed = 1;
+
+    if (failed)
+        printf("FAILED: exchanges lost at fast or normal speed, or less than twice the tick ISR's worst case\n");
+    return failed;
+}
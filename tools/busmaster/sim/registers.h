@@ -0,0 +1,21 @@
+#ifndef _KOREY_SIM_REGISTERS
+#define _KOREY_SIM_REGISTERS
+
+// ATtiny44 registers used by lib/kbus/src/bus.c, as plain memory that bussim.c drives. Forced in with -include.
+#include <stdint.h>
+
+extern volatile uint8_t sim_port_a[3]; // PINA, DDRA, PORTA, in the AVR order host.h expects
+extern volatile uint8_t sim_port_b[3];
+#define PORTA sim_port_a[2]
+#define PORTB sim_port_b[2]
+
+extern volatile uint8_t GIMSK, PCMSK0, PCMSK1, TIFR1, TIMSK1;
+extern volatile uint16_t TCNT1, OCR1A;
+
+#define PB3 3
+#define PCIE0 4
+#define PCIE1 5
+#define OCF1A 1
+#define OCIE1A 1
+
+#endif
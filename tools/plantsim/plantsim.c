@@ -0,0 +1,402 @@
+/*
+ * Closed-loop simulation of the controller heating a coop, for comparing thresholds and control changes
+ * without waiting for winter. The firmware's control loop pass (lib/kloop) runs once per timer tick, as the main
+ * loop runs it, with the thermistor or the DS18B20 driver behind the sensor interface, against:
+ *
+ *   - the coop, a first-order thermal mass warmed by the lamp and losing heat to the outside air,
+ *   - the outside air, a daily cycle per scenario with optional cold front,
+ *   - the sensor, lagging behind the coop air. The thermistor is read through the voltage divider with ADC noise;
+ *     the DS18B20 answers the driver's 1-Wire bit slots, converting in 750 ms at 1/16 degree celsius.
+ *
+ * One line per scenario:
+ *
+ *   <scenario> <overshoot> <undershoot> <% outside band> <relay switches> <% lamp duty> <readings>
+ *
+ * Overshoot and undershoot are the worst coop air temperatures above the high and below the low threshold,
+ * in degrees. Everything uses the coop air temperature, not what the sensor reported.
+ *
+ * Usage: plantsim [-l low] [-h high] [-o offset] [-d days] [-s seed] [-f] [-w]
+ *   -f reads the temperature every TIME_TEMP_READING ticks instead of using the adaptive sampler.
+ *   -w reads a DS18B20 instead of the thermistor (SENSOR_DS18B20 in src/main.c).
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "thermistor.h"
+#include "ds18b20.h"
+#include "control.h"
+#include "sensor.h"
+#include "clock.h"
+#include "loop.h"
+
+#define TICK_US 5056
+#define TICKS_PER_DAY ((unsigned long)(86400 / LOOP_TICK_SECONDS))
+#define AMBIENT_UPDATE_TICKS TIME_SECOND // The outside air does not change faster
+#define SENSOR_PIN 6
+
+#define DS18B20_CONVERSION_US 750000 // Longest at 12 bits
+#define ONEWIRE_RESET_US 480
+#define ONEWIRE_WRITE_ONE_US 15 // A write slot held low for less is a 1; a read slot is as short
+
+struct scenario_t
+{
+    const char *name;
+    float ambient_mean;  // Fahrenheit
+    float ambient_swing; // Half the day-night difference, coldest at 5 am
+    float front_drop;    // Degrees lost over front_hours, starting at noon on the first day
+    float front_hours;
+    float lamp_rise;     // Coop temperature above outside air with the lamp on for good
+    float coop_tau;      // Coop time constant in seconds
+    float sensor_tau;    // Thermistor lag in seconds
+    float adc_noise;     // Standard deviation of raw ADC samples in counts
+};
+
+static const struct scenario_t SCENARIOS[] =
+    {
+        {"mild", 42, 8, 0, 0, 35, 1800, 60, 1},
+        {"cold", 22, 10, 0, 0, 35, 1800, 60, 1},
+        {"arctic", -5, 6, 0, 0, 35, 1800, 60, 1},
+        {"front", 45, 6, 35, 6, 35, 1800, 60, 1},
+        {"drafty", 22, 10, 0, 0, 35, 600, 60, 1},
+        {"slow_sensor", 22, 10, 0, 0, 35, 1800, 300, 1},
+        {"noisy", 22, 10, 0, 0, 35, 1800, 60, 6},
+};
+
+enum onewire_state
+{
+    ONEWIRE_IDLE,
+    ONEWIRE_ROM,         // Receiving the ROM command after a reset
+    ONEWIRE_FUNCTION,    // Receiving the function command
+    ONEWIRE_CONVERTING,  // Read slots answer 0 until the conversion is done
+    ONEWIRE_SCRATCHPAD,  // Read slots shift out the scratchpad
+};
+
+// The DS18B20 end of the line. The driver only looks at the line after a delay, so the line is updated there.
+struct onewire_device_t
+{
+    enum onewire_state state;
+    uint8_t low;              // Pulling the line low during the current delay
+    unsigned long master_us;  // How long the driver has held the line low
+    uint8_t shift;            // Command bits received so far, LSB first
+    uint8_t bits;             // Bits of the current byte
+    uint8_t index;            // Scratchpad byte being sent
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+    double conversion_done;   // Simulated time in us
+};
+
+static const struct scenario_t *scenario;
+static struct thermistor_t t1;
+static float sensor_temperature;
+static volatile uint8_t port[3]; // PINx, DDRx, PORTx of the sensor pin
+static struct onewire_device_t onewire;
+static double now_us;
+
+/**
+ * @brief Standard normal deviate (Box-Muller).
+ */
+static float gaussian(void)
+{
+    float u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    float u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/**
+ * @brief Host ADC: the divider voltage at the sensor's temperature, interpolated between whole degrees of the
+ *        firmware's own inverse conversion, plus noise.
+ */
+uint16_t adc(uint8_t pin)
+{
+    (void)pin;
+
+    float degrees = floor(sensor_temperature);
+    float low = temperature_to_adc(&t1, degrees);
+    float high = temperature_to_adc(&t1, degrees + 1);
+    float counts = (low + (high - low) * (sensor_temperature - degrees)) / THERMISTOR_ADC_SCALE;
+
+    counts += gaussian() * scenario->adc_noise + 0.5;
+    if (counts < 0)
+        return 0;
+    return counts > ADC_MAX ? ADC_MAX : counts;
+}
+
+/**
+ * @brief Dallas/Maxim CRC-8, as the DS18B20 appends to its scratchpad.
+ */
+static uint8_t onewire_crc(const uint8_t *bytes, uint8_t length)
+{
+    uint8_t crc = 0;
+
+    while (length--)
+    {
+        crc ^= *bytes++;
+        for (uint8_t b = 0; b < 8; b++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Latch the sensor's temperature into the scratchpad and start converting.
+ */
+static void start_conversion(struct onewire_device_t *d)
+{
+    const long raw = lround((sensor_temperature - 32) * 5 / 9 * 16);
+    const uint8_t bytes[] = {raw & 0xFF, (raw >> 8) & 0xFF, 0x4B, 0x46, 0x7F, 0xFF, 0x01, 0x10};
+
+    for (uint8_t i = 0; i < sizeof(bytes); i++)
+        d->scratchpad[i] = bytes[i];
+    d->scratchpad[sizeof(bytes)] = onewire_crc(bytes, sizeof(bytes));
+    d->conversion_done = now_us + DS18B20_CONVERSION_US;
+    d->state = ONEWIRE_CONVERTING;
+}
+
+/**
+ * @brief The driver released the line after holding it low for low_us: a reset, or a write or read slot.
+ */
+static void onewire_released(struct onewire_device_t *d, unsigned long low_us)
+{
+    if (low_us >= ONEWIRE_RESET_US)
+    {
+        d->low = 1; // Presence pulse
+        d->state = ONEWIRE_ROM;
+        d->bits = 0;
+        return;
+    }
+
+    const uint8_t bit = low_us < ONEWIRE_WRITE_ONE_US;
+    switch (d->state)
+    {
+    case ONEWIRE_ROM:
+    case ONEWIRE_FUNCTION:
+        d->shift = d->shift >> 1 | bit << 7;
+        if (++d->bits < 8)
+            break;
+        d->bits = 0;
+        if (d->state == ONEWIRE_ROM)
+            d->state = d->shift == 0xCC ? ONEWIRE_FUNCTION : ONEWIRE_IDLE; // Skip ROM
+        else if (d->shift == 0x44)                                          // Convert
+            start_conversion(d);
+        else if (d->shift == 0xBE) // Read scratchpad
+        {
+            d->index = 0;
+            d->state = ONEWIRE_SCRATCHPAD;
+        }
+        else
+            d->state = ONEWIRE_IDLE;
+        break;
+
+    case ONEWIRE_CONVERTING:
+        d->low = now_us < d->conversion_done;
+        break;
+
+    case ONEWIRE_SCRATCHPAD:
+        if (d->index >= DS18B20_SCRATCHPAD_SIZE)
+            break;
+        d->low = !((d->scratchpad[d->index] >> d->bits) & 1);
+        if (++d->bits == 8)
+        {
+            d->bits = 0;
+            d->index++;
+        }
+        break;
+
+    default:
+    case ONEWIRE_IDLE:
+        break;
+    }
+}
+
+/**
+ * @brief Let us microseconds pass on the 1-Wire line, with the driver holding it as it is now.
+ */
+static void onewire_wait(unsigned long us)
+{
+    struct onewire_device_t *d = &onewire;
+    const uint8_t driver_low = _DDR(port[2]) & (1 << SENSOR_PIN);
+
+    // Whatever the device drove ended with the last delay.
+    d->low = 0;
+    if (driver_low)
+        d->master_us += us;
+    else if (d->master_us)
+    {
+        onewire_released(d, d->master_us);
+        d->master_us = 0;
+    }
+    now_us += us;
+
+    if (driver_low || d->low)
+        _PIN(port[2]) &= ~(1 << SENSOR_PIN);
+    else
+        _PIN(port[2]) |= (1 << SENSOR_PIN);
+}
+
+void sim_delay_cycles(unsigned long cycles)
+{
+    onewire_wait(cycles / (CLOCK_FAST_F_CPU / 1000000));
+}
+
+static float ambient(unsigned long tick)
+{
+    float hours = tick * LOOP_TICK_SECONDS / 3600;
+    float temperature = scenario->ambient_mean - scenario->ambient_swing * cos(2 * M_PI * (hours - 5) / 24);
+
+    if (scenario->front_hours && hours > 12)
+        temperature -= hours - 12 < scenario->front_hours ? scenario->front_drop * (hours - 12) / scenario->front_hours
+                                                          : scenario->front_drop;
+
+    return temperature;
+}
+
+int main(int argc, char **argv)
+{
+    int low = TEMP_LOW_DEFAULT;
+    int high = TEMP_HIGH_DEFAULT;
+    int offset = 0;
+    unsigned days = 7;
+    unsigned seed = 1;
+    int fixed_period = 0;
+    int use_ds18b20 = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:h:o:d:s:fw")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            low = atoi(optarg);
+            break;
+        case 'h':
+            high = atoi(optarg);
+            break;
+        case 'o':
+            offset = atoi(optarg);
+            break;
+        case 'd':
+            days = atoi(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        case 'f':
+            fixed_period = 1;
+            break;
+        case 'w':
+            use_ds18b20 = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: plantsim [-l low] [-h high] [-o offset] [-d days] [-s seed] [-f] [-w]\n");
+            return 1;
+        }
+    }
+    if (low >= high || !days)
+    {
+        fprintf(stderr, "plantsim: need low < high and at least one day\n");
+        return 1;
+    }
+
+    printf("# thresholds %d %d, offset %d, %u days, %s sampling, %s\n", low, high, offset, days,
+           fixed_period ? "fixed" : "adaptive", use_ds18b20 ? "DS18B20" : "thermistor");
+    printf("# scenario overshoot undershoot outside%% switches duty%% readings\n");
+
+    const float tick_hours = LOOP_TICK_SECONDS / 3600;
+    const uint16_t min_period = fixed_period ? TIME_TEMP_READING : TIME_TEMP_READING_MIN;
+    const uint16_t max_period = fixed_period ? TIME_TEMP_READING : TIME_TEMP_READING_MAX;
+    unsigned long simulated_ticks = 0;
+    clock_t started = clock();
+
+    for (unsigned s = 0; s < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); s++)
+    {
+        struct ds18b20_t ds1;
+        struct controller_t ctl1;
+        struct sensor_t sensor1;
+        struct control_loop_t loop1;
+
+        scenario = &SCENARIOS[s];
+        srand(seed);
+
+        // Start in the middle of the band, lamp off.
+        float coop = (low + high) / 2.0;
+        sensor_temperature = coop;
+        float outside = ambient(0);
+
+        // Released line, pulled up.
+        onewire = (struct onewire_device_t){0};
+        port[1] = 0;
+        port[0] = 1 << SENSOR_PIN;
+
+        // The thermistor is always set up: the host ADC converts with it.
+        init_thermistor(&t1, &port[2], SENSOR_PIN, THERMISTOR_BCOEFFICIENT, THERMISTOR_SERIES_RESISTOR,
+                        THERMISTOR_RESISTANCE_NOMINAL, THERMISTOR_TEMP_NOMINAL);
+        if (use_ds18b20)
+        {
+            init_ds18b20(&ds1, &port[2], SENSOR_PIN);
+            init_sensor(&sensor1, &DS18B20_SENSOR, &ds1);
+        }
+        else
+            init_sensor(&sensor1, &THERMISTOR_SENSOR, &t1);
+        init_controller(&ctl1, &sensor1, low, high);
+        set_controller_thresholds(&ctl1, low, high, offset);
+        init_control_loop(&loop1, &sensor1, &ctl1, min_period, max_period);
+
+        const float coop_alpha = 1 - exp(-LOOP_TICK_SECONDS / scenario->coop_tau);
+        const float sensor_alpha = 1 - exp(-LOOP_TICK_SECONDS / scenario->sensor_tau);
+        const unsigned long ticks = days * TICKS_PER_DAY;
+
+        unsigned long readings = 0, switches = 0, on_ticks = 0, outside_ticks = 0;
+        float overshoot = 0, undershoot = 0;
+        uint8_t relay = 0;
+
+        for (unsigned long tick = 0; tick < ticks; tick++)
+        {
+            if (tick % AMBIENT_UPDATE_TICKS == 0)
+                outside = ambient(tick);
+
+            // Main loop pass, then the rest of the tick. A DS18B20 reset pulse lasts from one pass to the next.
+            readings += step_control_loop(&loop1, &sensor1, &ctl1, tick);
+            if (use_ds18b20)
+                onewire_wait(TICK_US);
+            if (get_sensor_error(&sensor1))
+            {
+                printf("%s sensor error after %.1f hours\n", scenario->name, tick * tick_hours);
+                break;
+            }
+            switches += ctl1.relay != relay;
+            relay = ctl1.relay;
+
+            // Plant, one tick.
+            coop += (outside + (relay ? scenario->lamp_rise : 0) - coop) * coop_alpha;
+            sensor_temperature += (coop - sensor_temperature) * sensor_alpha;
+
+            on_ticks += relay;
+            if (coop > high)
+            {
+                outside_ticks++;
+                if (coop - high > overshoot)
+                    overshoot = coop - high;
+            }
+            else if (coop < low)
+            {
+                outside_ticks++;
+                if (low - coop > undershoot)
+                    undershoot = low - coop;
+            }
+        }
+
+        simulated_ticks += ticks;
+        printf("%s %.1f %.1f %.1f %lu %.1f %lu\n", scenario->name, overshoot, undershoot,
+               100.0 * outside_ticks / ticks, switches, 100.0 * on_ticks / ticks, readings);
+    }
+
+    double elapsed = (double)(clock() - started) / CLOCKS_PER_SEC;
+    printf("# %.0f simulated hours in %.1f s, %.0fx real time\n", simulated_ticks * tick_hours, elapsed,
+           simulated_ticks * LOOP_TICK_SECONDS / (elapsed > 0 ? elapsed : 1));
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _KOREY_SIM_DELAY
+#define _KOREY_SIM_DELAY
+
+// Cycle-counted delays in lib/kds18b20/src/ds18b20.c advance plantsim.c's simulated 1-Wire line instead of
+// spinning. Forced in with -include.
+void sim_delay_cycles(unsigned long cycles);
+#define __builtin_avr_delay_cycles(cycles) sim_delay_cycles(cycles)
+
+#endif
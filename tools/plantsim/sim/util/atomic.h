@@ -0,0 +1,8 @@
+#ifndef _KOREY_SIM_ATOMIC
+#define _KOREY_SIM_ATOMIC
+
+// Nothing preempts the simulated CPU: plantsim.c has no interrupts.
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (int _done = (type); !_done; _done = 1)
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Replay a trace recorded with TRACE_ENABLE (see lib/ktrace/src/trace.h) through the firmware's thermistor
+ * filtering and relay control on the host, printing one line per temperature reading:
+ *
+ *   <tick> <displayed temperature> <relay>
+ *
+ * Threshold changes print "<tick> thresholds <low> <high> <offset> <relay>", with the relay state the firmware
+ * switches to on its next pass, without waiting for a reading. Ticks are unwrapped to 32 bits. Input events are
+ * echoed as "<tick> event <type>" so output from two builds can be compared with diff.
+ *
+ * Usage: replay [trace file]   (reads standard input without an argument)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "thermistor.h"
+#include "control.h"
+#include "sensor.h"
+#include "loop.h"
+#include "trace.h"
+
+struct record_t
+{
+    uint32_t tick;
+    char type;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+};
+
+static struct record_t *records;
+static size_t record_count;
+static size_t pos;
+
+static void load_trace(FILE *f)
+{
+    char line[128];
+    size_t capacity = 0;
+    uint32_t tick_high = 0;
+    unsigned int last_tick = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned int tick, a = 0, b = 0, c = 0;
+        char type;
+
+        // Headers, comments and unrelated simulator output are skipped.
+        if (sscanf(line, "%x %c %x %x %x", &tick, &type, &a, &b, &c) < 2 || tick > 0xFFFF)
+            continue;
+
+        if (record_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            records = realloc(records, capacity * sizeof(*records));
+            if (!records)
+            {
+                perror("replay");
+                exit(1);
+            }
+        }
+
+        if (tick < last_tick)
+            tick_high += 0x10000;
+        last_tick = tick;
+
+        records[record_count++] = (struct record_t){tick_high + tick, type, a, b, c};
+    }
+}
+
+/**
+ * @brief Host ADC: hand out the recorded samples in order.
+ */
+uint16_t adc(uint8_t pin)
+{
+    (void)pin;
+
+    if (pos >= record_count)
+    {
+        fprintf(stderr, "replay: trace ended in the middle of a reading\n");
+        exit(0);
+    }
+    if (records[pos].type != TRACE_ADC)
+    {
+        fprintf(stderr, "replay: expected ADC sample at tick %u, got '%c'\n", records[pos].tick, records[pos].type);
+        exit(1);
+    }
+
+    return records[pos++].a;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f = stdin;
+    if (argc > 1 && !(f = fopen(argv[1], "r")))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    load_trace(f);
+
+    static uint8_t port[3]; // PINx, DDRx, PORTx
+    struct thermistor_t t1;
+    struct controller_t ctl1;
+    struct sensor_t sensor1;
+
+    init_thermistor(&t1, &port[2], 6, THERMISTOR_BCOEFFICIENT, THERMISTOR_SERIES_RESISTOR,
+                    THERMISTOR_RESISTANCE_NOMINAL, THERMISTOR_TEMP_NOMINAL);
+    init_sensor(&sensor1, &THERMISTOR_SENSOR, &t1);
+    init_controller(&ctl1, &sensor1, 0, 0);
+
+    while (pos < record_count)
+    {
+        const struct record_t *r = &records[pos];
+
+        switch (r->type)
+        {
+        case TRACE_ADC:
+        {
+            read_sensor(&sensor1);
+
+            int16_t temperature = (int16_t)get_sensor_temperature(&sensor1) + ctl1.offset;
+            if (get_sensor_error(&sensor1))
+            {
+                printf("%u ERR 0\n", r->tick);
+                return 0;
+            }
+            printf("%u %d %u\n", r->tick, temperature, update_controller(&ctl1, get_sensor_value(&sensor1)));
+            break;
+        }
+
+        case TRACE_THRESHOLDS:
+            set_controller_thresholds(&ctl1, (int16_t)r->a, (int16_t)r->b, (int16_t)r->c);
+            // The firmware runs the controller on every pass, not only after readings.
+            printf("%u thresholds %d %d %d %u\n", r->tick, ctl1.low_thresh, ctl1.high_thresh, ctl1.offset,
+                   update_controller(&ctl1, get_sensor_value(&sensor1)));
+            pos++;
+            break;
+
+        default:
+            printf("%u event %c\n", r->tick, r->type);
+            pos++;
+            break;
+        }
+    }
+
+    return 0;
+}